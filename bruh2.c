@@ -1,32 +1,60 @@
+// gcc -O2 -Wall -Wextra -std=c11 bruh2.c -lncurses -lm -pthread -o neotop
+
 #define _GNU_SOURCE
 #define _POSIX_C_SOURCE 200809L
 
+#include <arpa/inet.h>
 #include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <ifaddrs.h>
+#include <limits.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <linux/taskstats.h>
+#include <malloc.h>
 #include <math.h>
 #include <ncurses.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <poll.h>
 #include <pwd.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <sys/utsname.h>
 #include <time.h>
 #include <unistd.h>
 
 // ---------- Tunables ----------
 #define MAX_CORES 128
-#define MAX_PROCS 2048
 #define MAX_COMM 64
 #define HIST_W 120
+#define HIST_SCALE 10000 // fixed-point scale of a usage fraction
 #define CPU_MS 250
 #define PROC_MS 1500
-#define FRAME_MS 166
+#define SENSOR_MS 500
+#define THREAD_MS 500
 #define CONTENT_WIDTH 100
 #define MAX_PRIORITY_PROCS 10
 
@@ -72,6 +100,129 @@ static inline long now_ms(void) {
   return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
 }
 
+static inline long long now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// ---------- Self Profile ----------
+// Each collection and render stage records its duration into a ring that
+// only the thread running that stage writes, so a stage pays two clock reads
+// and a store. Percentiles are worked out from a ring only when somebody
+// looks: the 'P' overlay, or headless records with -P.
+#define PROF_RING 128
+
+typedef struct {
+  uint32_t ns[PROF_RING];
+  unsigned n; // samples recorded so far
+} ProfRing;
+
+typedef struct {
+  uint32_t p50, p99; // ns, over the last PROF_RING samples
+} ProfStat;
+
+// Sampler-side stages; the UI keeps its own rings next to the pages.
+enum { PS_CPU, PS_MEM, PS_SENS, PS_SCAN, PS_PIDS, NPS };
+static const char *ps_name[NPS] = {"cpu_sample", "mem_read", "sensors",
+                                   "scan", "pid_reads"};
+static ProfRing prof[NPS];
+static atomic_bool prof_on; // overlay shown or -P given
+
+static void prof_add(ProfRing *r, long long t0) {
+  long long d = now_ns() - t0;
+  r->ns[r->n++ % PROF_RING] = d > UINT32_MAX ? UINT32_MAX : (uint32_t)d;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+static ProfStat prof_stat(const ProfRing *r) {
+  uint32_t v[PROF_RING];
+  unsigned k = r->n < PROF_RING ? r->n : PROF_RING;
+  if (!k)
+    return (ProfStat){0, 0};
+  memcpy(v, r->ns, k * sizeof(v[0]));
+  qsort(v, k, sizeof(v[0]), cmp_u32);
+  return (ProfStat){v[k / 2], v[(k * 99) / 100 < k ? (k * 99) / 100 : k - 1]};
+}
+
+// ---------- Wakeups ----------
+// ui_evfd wakes the UI's ppoll(); it is signalled on every snapshot publish
+// and when background work such as the neofetch probe finishes.
+static int ui_evfd = -1;
+
+static void evfd_signal(int fd) {
+  uint64_t one = 1;
+  // EAGAIN means the counter is saturated, which still reads as pending.
+  ssize_t r = write(fd, &one, sizeof(one));
+  (void)r;
+}
+
+// Reads and clears an eventfd or timerfd; true if it had fired.
+static bool evfd_drain(int fd) {
+  uint64_t n;
+  return read(fd, &n, sizeof(n)) == (ssize_t)sizeof(n);
+}
+
+// ---------- procfs ----------
+// Every collector opens its files relative to proc_root_fd(), so -r (and the
+// bench) can point them all at another tree. neotop's own /proc/self figures
+// always come from the real /proc.
+static const char *proc_root = "/proc";
+static int proc_dfd = -1;
+static long page_kb = 4;
+static long ticks_per_sec = 100;
+static int proc_root_fd(void) {
+  if (proc_dfd < 0) {
+    proc_dfd = open(proc_root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    long ps = sysconf(_SC_PAGESIZE);
+    if (ps > 0)
+      page_kb = ps / 1024;
+    long tck = sysconf(_SC_CLK_TCK);
+    if (tck > 0)
+      ticks_per_sec = tck;
+  }
+  return proc_dfd;
+}
+
+static const char *skip_fields(const char *p, const char *end, int n) {
+  while (n-- > 0) {
+    while (p < end && *p != ' ')
+      p++;
+    while (p < end && *p == ' ')
+      p++;
+  }
+  return p;
+}
+
+static unsigned long long scan_ull(const char **pp, const char *end) {
+  const char *p = *pp;
+  unsigned long long v = 0;
+  while (p < end && (unsigned)(*p - '0') < 10)
+    v = v * 10 + (unsigned)(*p++ - '0');
+  *pp = p;
+  return v;
+}
+
+static long long scan_ll(const char **pp, const char *end) {
+  if (*pp < end && **pp == '-') {
+    (*pp)++;
+    return -(long long)scan_ull(pp, end);
+  }
+  return (long long)scan_ull(pp, end);
+}
+
+static ssize_t read_retry(int fd, char *buf, size_t n, off_t off) {
+  ssize_t r;
+  do
+    r = (off < 0) ? read(fd, buf, n) : pread(fd, buf, n, off);
+  while (r < 0 && errno == EINTR);
+  return r;
+}
+
 // ---------- System Info ----------
 static int NCPU = 1;
 static char cpu_model[128] = "Unknown CPU";
@@ -151,9 +302,31 @@ static void read_uptime(int *h, int *m, int *s) {
 }
 
 // ---------- Temp/Freq ----------
+// detect_temp_sensor() finds the thermal zone and the per-core cpufreq files
+// once and keeps them open. The sampler re-reads them with pread() every
+// SENSOR_MS while a page shows them and publishes the readings in the
+// snapshot, so the draw functions never touch sysfs.
+typedef struct {
+  double temp_c; // smoothed
+  double freq_mhz[MAX_CORES];
+  double freq_avg; // over the cores that report one, 0 if none do
+  bool temp_ok;    // temp_c comes from a sensor
+} SensorSnap;
+
 static char tz_path[128] = "";
-static double temp_smooth = 0.0;
 static bool temp_available = false;
+static int temp_fd = -1;
+static int freq_fd[MAX_CORES];
+static int sens_nfds = 0;
+static SensorSnap sens = {0};
+
+static bool sensor_open(const char *path, int *fd) {
+  *fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (*fd < 0)
+    return false;
+  sens_nfds++;
+  return true;
+}
 
 static void detect_temp_sensor(void) {
   const char *temp_paths[] = {"/sys/class/thermal/thermal_zone0/temp",
@@ -161,10 +334,16 @@ static void detect_temp_sensor(void) {
                               "/sys/class/hwmon/hwmon1/temp1_input",
                               "/sys/class/hwmon/hwmon2/temp1_input", NULL};
 
+  for (int i = 0; i < MAX_CORES; i++) {
+    char path[96];
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", i);
+    if (i >= NCPU || !sensor_open(path, &freq_fd[i]))
+      freq_fd[i] = -1;
+  }
+
   for (int i = 0; temp_paths[i] != NULL; i++) {
-    FILE *f = fopen(temp_paths[i], "r");
-    if (f) {
-      fclose(f);
+    if (sensor_open(temp_paths[i], &temp_fd)) {
       strncpy(tz_path, temp_paths[i], sizeof(tz_path) - 1);
       temp_available = true;
       return;
@@ -186,196 +365,791 @@ static void detect_temp_sensor(void) {
         strstr(type, "soc") || strstr(type, "core")) {
       snprintf(tz_path, sizeof(tz_path),
                "/sys/class/thermal/thermal_zone%d/temp", i);
-      temp_available = true;
-      return;
+      if (sensor_open(tz_path, &temp_fd)) {
+        temp_available = true;
+        return;
+      }
     }
   }
 
+  tz_path[0] = '\0';
   temp_available = false;
 }
 
-static double temp_c(void) {
-  if (!temp_available || !tz_path[0])
-    return temp_smooth;
-  FILE *f = fopen(tz_path, "r");
-  if (!f)
-    return temp_smooth;
-  double t = 0;
-  fscanf(f, "%lf", &t);
-  fclose(f);
-  t /= 1000.0;
-  temp_smooth = (temp_smooth == 0.0) ? t : (0.7 * temp_smooth + 0.3 * t);
-  return temp_smooth;
+static bool sensor_read(int fd, long long *v) {
+  char buf[32];
+  ssize_t n = read_retry(fd, buf, sizeof(buf), 0);
+  if (n <= 0)
+    return false;
+  const char *p = buf;
+  const char *end = buf + n;
+  if (*p != '-' && (unsigned)(*p - '0') >= 10)
+    return false;
+  *v = scan_ll(&p, end);
+  return true;
 }
 
-static void read_cpu_freq_mhz(double *freqs) {
-  bool freq_found = false;
-  for (int i = 0; i < NCPU && i < MAX_CORES; i++) {
-    char path[128];
-    snprintf(path, sizeof(path),
-             "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", i);
-    FILE *f = fopen(path, "r");
-    if (f) {
-      unsigned long khz = 0;
-      if (fscanf(f, "%lu", &khz) == 1) {
-        freqs[i] = khz / 1000.0;
-        freq_found = true;
-      }
-      fclose(f);
+static void sens_freq_avg(int ncores) {
+  double sum = 0;
+  int n = 0;
+  for (int i = 0; i < ncores && i < MAX_CORES; i++) {
+    if (sens.freq_mhz[i] > 0) {
+      sum += sens.freq_mhz[i];
+      n++;
     }
   }
+  sens.freq_avg = n ? sum / n : 0;
+}
 
-  if (!freq_found && cpu_freq_ghz > 0) {
-    for (int i = 0; i < NCPU && i < MAX_CORES; i++) {
-      freqs[i] = cpu_freq_ghz * 1000.0;
-    }
+static void sensors_sample(void) {
+  long long t0 = now_ns();
+  long long v;
+  sens.temp_ok = temp_available;
+  if (temp_fd >= 0 && sensor_read(temp_fd, &v)) {
+    double t = v / 1000.0;
+    sens.temp_c = (sens.temp_c == 0.0) ? t : (0.7 * sens.temp_c + 0.3 * t);
   }
 
-  if (!freq_found && cpu_freq_ghz == 0) {
-    for (int i = 0; i < NCPU && i < MAX_CORES; i++) {
-      freqs[i] = 0;
+  bool freq_found = false;
+  for (int i = 0; i < NCPU && i < MAX_CORES; i++) {
+    if (freq_fd[i] >= 0 && sensor_read(freq_fd[i], &v)) {
+      sens.freq_mhz[i] = v / 1000.0;
+      freq_found = true;
     }
   }
+
+  if (!freq_found) {
+    for (int i = 0; i < NCPU && i < MAX_CORES; i++)
+      sens.freq_mhz[i] = cpu_freq_ghz * 1000.0;
+  }
+  sens_freq_avg(NCPU);
+  prof_add(&prof[PS_SENS], t0);
 }
 
 // ---------- Memory ----------
-static int mem_read_kb(unsigned long *tot, unsigned long *free_kb,
-                       unsigned long *avail) {
-  FILE *f = fopen("/proc/meminfo", "r");
-  if (!f)
+// /proc/meminfo is sampled once per tick like /proc/stat: one pread through
+// a persistent descriptor, then a line walk that matches keys by length
+// before comparing bytes and stops as soon as every wanted key was seen.
+typedef struct {
+  unsigned long total_kb, free_kb, avail_kb;
+  unsigned long buffers_kb, cached_kb;
+  unsigned long swap_total_kb, swap_free_kb;
+} MemSnap;
+static MemSnap mem = {0};
+
+#define MEM_KEY(k, f) {k ":", sizeof(k), offsetof(MemSnap, f)}
+static const struct {
+  const char *key;
+  size_t len; // including the colon
+  size_t off;
+} mem_keys[] = {
+    MEM_KEY("MemTotal", total_kb),       MEM_KEY("MemFree", free_kb),
+    MEM_KEY("MemAvailable", avail_kb),   MEM_KEY("Buffers", buffers_kb),
+    MEM_KEY("Cached", cached_kb),        MEM_KEY("SwapTotal", swap_total_kb),
+    MEM_KEY("SwapFree", swap_free_kb),
+};
+#undef MEM_KEY
+#define N_MEM_KEYS (int)(sizeof(mem_keys) / sizeof(mem_keys[0]))
+
+static char meminfo_buf[4096];
+static int meminfo_fd = -1;
+
+static int mem_read_kb(MemSnap *out) {
+  if (meminfo_fd < 0) {
+    int dfd = proc_root_fd();
+    if (dfd < 0)
+      return -1;
+    meminfo_fd = openat(dfd, "meminfo", O_RDONLY | O_CLOEXEC);
+    if (meminfo_fd < 0)
+      return -1;
+  }
+  ssize_t len = read_retry(meminfo_fd, meminfo_buf, sizeof(meminfo_buf), 0);
+  if (len <= 0)
     return -1;
-  char k[64];
-  unsigned long v;
-  *tot = *free_kb = *avail = 0;
-  while (fscanf(f, "%63s %lu kB", k, &v) == 2) {
-    if (!strcmp(k, "MemTotal:"))
-      *tot = v;
-    else if (!strcmp(k, "MemFree:"))
-      *free_kb = v;
-    else if (!strcmp(k, "MemAvailable:"))
-      *avail = v;
-    int c;
-    while ((c = fgetc(f)) != '\n' && c != EOF)
-      ;
+
+  MemSnap m = {0};
+  unsigned found = 0, all = (1u << N_MEM_KEYS) - 1;
+  const char *p = meminfo_buf, *end = meminfo_buf + len;
+  while (p < end && found != all) {
+    const char *eol = memchr(p, '\n', (size_t)(end - p));
+    if (!eol)
+      eol = end;
+    const char *colon = memchr(p, ':', (size_t)(eol - p));
+    if (colon) {
+      size_t klen = (size_t)(colon - p) + 1;
+      for (int i = 0; i < N_MEM_KEYS; i++) {
+        if ((found >> i & 1u) || mem_keys[i].len != klen ||
+            memcmp(p, mem_keys[i].key, klen) != 0)
+          continue;
+        const char *q = colon + 1;
+        while (q < eol && *q == ' ')
+          q++;
+        *(unsigned long *)((char *)&m + mem_keys[i].off) = scan_ull(&q, eol);
+        found |= 1u << i;
+        break;
+      }
+    }
+    p = eol + 1;
   }
-  fclose(f);
+  *out = m;
   return 0;
 }
 
 // ---------- Memory History ----------
-static double hist_mem[HIST_W];
+static uint16_t hist_mem[HIST_W]; // used fraction * HIST_SCALE
 static int mem_hpos = 0;
 
-static void push_mem_hist(void) {
-  unsigned long mt = 0, mf = 0, ma = 0;
-  mem_read_kb(&mt, &mf, &ma);
+static void mem_hist_add(void) {
+  unsigned long mt = mem.total_kb, ma = mem.avail_kb;
   double used_pct = mt ? (double)(mt - ma) / mt : 0.0;
-  hist_mem[mem_hpos] = used_pct;
+  hist_mem[mem_hpos] = (uint16_t)lround(used_pct * HIST_SCALE);
   mem_hpos = (mem_hpos + 1) % HIST_W;
 }
 
+static void push_mem_hist(void) {
+  long long t0 = now_ns();
+  mem_read_kb(&mem);
+  prof_add(&prof[PS_MEM], t0);
+  mem_hist_add();
+}
+
+// ---------- Pressure Stall ----------
+// /proc/pressure/{cpu,memory,io} shows contention before utilization
+// saturates: the share of wall time in which some (or all) runnable tasks
+// were stalled on the resource. Each file is pread through a persistent
+// descriptor on the sensor tick; the kernel only refreshes the averages
+// every two seconds. A kernel without PSI fails the first open and the
+// pages show n/a from then on.
+enum { PSI_CPU, PSI_MEM, PSI_IO, NPSI };
+static const char *psi_file[NPSI] = {"pressure/cpu", "pressure/memory",
+                                     "pressure/io"};
+static const char *psi_name[NPSI] = {"cpu", "mem", "io"};
+
+typedef struct {
+  // Hundredths of a percent. The cpu "full" line is zero on kernels that
+  // report it at all.
+  uint16_t some10, some60, full10, full60;
+} PsiRes;
+
+typedef struct {
+  PsiRes res[NPSI];
+  bool ok;
+} PsiSnap;
+static PsiSnap psi = {0};
+static int psi_fd[NPSI] = {-1, -1, -1};
+static bool psi_tried = false;
+
+// "avg10=12.34" -> 1234; only the first two decimals are kept.
+static uint16_t psi_avg(const char *p, const char *eol, const char *key) {
+  size_t kl = strlen(key);
+  for (; p + kl < eol; p++) {
+    if (memcmp(p, key, kl) != 0)
+      continue;
+    p += kl;
+    unsigned long long v = scan_ull(&p, eol) * 100;
+    if (p < eol && *p == '.') {
+      p++;
+      for (int d = 10; d >= 1; d /= 10, p++)
+        if (p < eol && *p >= '0' && *p <= '9')
+          v += (unsigned long long)(*p - '0') * (unsigned)d;
+        else
+          break;
+    }
+    return (uint16_t)(v < 10000 ? v : 10000);
+  }
+  return 0;
+}
+
+static void psi_sample(void) {
+  if (!psi_tried) {
+    psi_tried = true;
+    int dfd = proc_root_fd();
+    for (int r = 0; r < NPSI && dfd >= 0; r++)
+      psi_fd[r] = openat(dfd, psi_file[r], O_RDONLY | O_CLOEXEC);
+  }
+  char buf[256];
+  bool ok = false;
+  for (int r = 0; r < NPSI; r++) {
+    PsiRes *pr = &psi.res[r];
+    ssize_t len =
+        psi_fd[r] < 0 ? -1 : read_retry(psi_fd[r], buf, sizeof(buf), 0);
+    if (len <= 0) {
+      memset(pr, 0, sizeof(*pr));
+      continue;
+    }
+    ok = true;
+    const char *p = buf, *end = buf + len;
+    while (p < end) {
+      const char *eol = memchr(p, '\n', (size_t)(end - p));
+      if (!eol)
+        eol = end;
+      bool full = eol - p > 4 && memcmp(p, "full", 4) == 0;
+      uint16_t a10 = psi_avg(p, eol, "avg10="), a60 = psi_avg(p, eol, "avg60=");
+      if (full) {
+        pr->full10 = a10;
+        pr->full60 = a60;
+      } else {
+        pr->some10 = a10;
+        pr->some60 = a60;
+      }
+      p = eol + 1;
+    }
+  }
+  psi.ok = ok;
+}
+
 // ---------- CPU Sampling + History ----------
+// /proc/stat is read once per tick through a persistent descriptor into a
+// preallocated buffer. Per-core usage feeds the graphs; the aggregate jiffy
+// counter is also the denominator for per-process CPU%.
+//
+// The short per-core history is time-major: one row of ncores uint16_t per
+// tick. A reduction across cores at one sample reads a contiguous row, and
+// per-core reductions over the window are element-wise min/max/add down the
+// rows, so both loops vectorize.
+//
+// Busy time is also split by category per tick, so steal and iowait stay
+// visible instead of disappearing into one usage ratio: user includes nice,
+// system includes irq and softirq.
+enum { CAT_USER, CAT_SYS, CAT_IOW, CAT_STEAL, NCAT };
 typedef struct {
   double total;
   double core[MAX_CORES];
+  uint16_t cat[MAX_CORES + 1][NCAT]; // [0] aggregate; HIST_SCALE units
   int ncores;
+  int nstat; // per-CPU lines in /proc/stat, including those past MAX_CORES
+  unsigned long long jiffies;  // cumulative aggregate over all CPUs
+  unsigned long long djiffies; // aggregate delta over the last tick
 } CpuSnap;
 static CpuSnap cpu = {0};
-static double hist_cpu[MAX_CORES][HIST_W];
-static int hpos = 0;
+static uint16_t hist_core[HIST_W][MAX_CORES];
+static uint16_t hist_cat[HIST_W][NCAT]; // aggregate categories, same rows
+static int hpos = 0, hist_n = 0;
 
 static void push_hist(void) {
+  memcpy(hist_cat[hpos], cpu.cat[0], sizeof(hist_cat[0]));
+  uint16_t *row = hist_core[hpos];
   for (int i = 0; i < cpu.ncores && i < MAX_CORES; i++) {
     double usage = cpu.core[i];
     if (usage < 0.0)
       usage = 0.0;
     if (usage > 1.0)
       usage = 1.0;
-    hist_cpu[i][hpos] = usage;
+    row[i] = (uint16_t)lround(usage * HIST_SCALE);
   }
   hpos = (hpos + 1) % HIST_W;
+  if (hist_n < HIST_W)
+    hist_n++;
+}
+
+// Window statistics over hist_core, all in HIST_SCALE units. p95 comes from
+// a 1%-bin histogram per core.
+typedef struct {
+  uint16_t min, avg, max, p95;
+} CoreStat;
+
+typedef struct {
+  CoreStat core[MAX_CORES];
+  uint16_t all_avg, all_peak; // mean over cores per sample: window avg, max
+  uint16_t cat[HIST_W][NCAT]; // aggregate categories, oldest first
+  int ncores, nsamp;
+} CoreHist;
+static CoreHist core_hist;
+
+// Row kernels: branch-free, restrict-qualified, on small integer types and
+// over the full MAX_CORES row (unused cores stay 0) so that even -O2's cheap
+// vectorizer turns them into SIMD min/max/add without a scalar tail. Usage
+// never exceeds HIST_SCALE, so the running min/max fit int16_t, which has
+// SSE2 min/max.
+static void row_accumulate(const uint16_t *restrict row, int16_t *restrict mn,
+                           int16_t *restrict mx, uint32_t *restrict sum) {
+  for (int c = 0; c < MAX_CORES; c++) {
+    int16_t v = (int16_t)row[c];
+    mn[c] = v < mn[c] ? v : mn[c];
+    mx[c] = v > mx[c] ? v : mx[c];
+    sum[c] += row[c];
+  }
+}
+
+static uint32_t row_total(const uint16_t *restrict row) {
+  uint32_t t = 0;
+  for (int c = 0; c < MAX_CORES; c++)
+    t += row[c];
+  return t;
+}
+
+static void hist_reduce(CoreHist *out) {
+  static uint16_t bins[MAX_CORES][101];
+  int nc = cpu.ncores < MAX_CORES ? cpu.ncores : MAX_CORES, ns = hist_n;
+  out->ncores = nc;
+  out->nsamp = ns;
+  if (nc <= 0 || ns <= 0)
+    return;
+
+  int16_t mn[MAX_CORES], mx[MAX_CORES];
+  uint32_t sum[MAX_CORES] = {0};
+  for (int c = 0; c < MAX_CORES; c++)
+    mn[c] = mx[c] = (int16_t)hist_core[0][c];
+  memset(bins, 0, (size_t)nc * sizeof(bins[0]));
+  uint64_t all_sum = 0;
+  uint32_t all_peak = 0;
+
+  for (int t = 0; t < ns; t++) {
+    const uint16_t *row = hist_core[t];
+    row_accumulate(row, mn, mx, sum);
+    for (int c = 0; c < nc; c++)
+      bins[c][row[c] / (HIST_SCALE / 100)]++;
+    uint32_t mean = row_total(row) / (uint32_t)nc;
+    all_sum += mean;
+    if (mean > all_peak)
+      all_peak = mean;
+  }
+
+  int tail = ns - (ns * 95 + 99) / 100; // samples above the 95th percentile
+  for (int c = 0; c < nc; c++) {
+    int b = 100, seen = bins[c][100];
+    while (b > 0 && seen <= tail)
+      seen += bins[c][--b];
+    CoreStat *cs = &out->core[c];
+    cs->min = (uint16_t)mn[c];
+    cs->max = (uint16_t)mx[c];
+    cs->avg = (uint16_t)(sum[c] / (uint32_t)ns);
+    cs->p95 = (uint16_t)(b * (HIST_SCALE / 100));
+  }
+  out->all_avg = (uint16_t)(all_sum / (uint64_t)ns);
+  out->all_peak = (uint16_t)all_peak;
+
+  // Until the ring wraps the oldest row is row 0.
+  int old = ns < HIST_W ? 0 : hpos;
+  for (int t = 0; t < ns; t++)
+    memcpy(out->cat[t], hist_cat[(old + t) % HIST_W], sizeof(out->cat[0]));
+}
+
+// The cpu lines come first, so the tail of a large /proc/stat (intr, softirq)
+// may be cut off; it is never parsed.
+static char procstat_buf[(MAX_CORES + 2) * 160];
+static int procstat_fd = -1;
+
+// proc(5): per-CPU iowait can go down, and the other counters may step
+// back across a CPU going offline. A counter that went backwards counts as
+// no time spent, not as an unsigned wrap.
+static unsigned long long tick_delta(unsigned long long now,
+                                     unsigned long long prev) {
+  return now > prev ? now - prev : 0;
+}
+
+static uint16_t cat_frac(unsigned long long d, unsigned long long dt) {
+  return dt ? (uint16_t)(d >= dt ? HIST_SCALE : d * HIST_SCALE / dt) : 0;
 }
 
 static void cpu_sample(void) {
-  static unsigned long long pu[MAX_CORES + 1], pn[MAX_CORES + 1],
-      ps[MAX_CORES + 1], pi[MAX_CORES + 1], piow[MAX_CORES + 1],
-      pirq[MAX_CORES + 1], psirq[MAX_CORES + 1], psteal[MAX_CORES + 1];
+  static unsigned long long ptot[MAX_CORES + 1], pidle[MAX_CORES + 1];
+  static unsigned long long pcat[MAX_CORES + 1][NCAT];
   static int initialized = 0;
+  long long t0 = now_ns();
 
-  FILE *f = fopen("/proc/stat", "r");
-  if (!f)
+  if (procstat_fd < 0) {
+    int dfd = proc_root_fd();
+    if (dfd < 0)
+      return;
+    procstat_fd = openat(dfd, "stat", O_RDONLY | O_CLOEXEC);
+    if (procstat_fd < 0)
+      return;
+  }
+  ssize_t len =
+      read_retry(procstat_fd, procstat_buf, sizeof(procstat_buf), 0);
+  if (len <= 0)
     return;
-  int idx = 0;
-  char id[16];
-  unsigned long long u = 0, n = 0, s = 0, idle = 0, iow = 0, irq = 0, sirq = 0,
-                     steal = 0;
 
-  while (idx <= MAX_CORES) {
-    int items = fscanf(f, "%15s %llu %llu %llu %llu %llu %llu %llu %llu", id,
-                       &u, &n, &s, &idle, &iow, &irq, &sirq, &steal);
-
-    if (items < 9 || strncmp(id, "cpu", 3) != 0)
+  const char *p = procstat_buf, *end = procstat_buf + len;
+  int ncores = 0, nstat = 0;
+  bool cut = false;
+  while (p + 3 < end && p[0] == 'c' && p[1] == 'p' && p[2] == 'u') {
+    const char *eol = memchr(p, '\n', (size_t)(end - p));
+    if (!eol) {
+      cut = true; // truncated line
       break;
+    }
+    p += 3;
+    int idx = 0;
+    if (*p != ' ') {
+      idx = (int)scan_ull(&p, eol) + 1;
+      nstat++;
+    }
+    if (idx > MAX_CORES) {
+      p = eol + 1;
+      continue;
+    }
 
-    unsigned long long tot = u + n + s + idle + iow + irq + sirq + steal;
-    unsigned long long pt = pu[idx] + pn[idx] + ps[idx] + pi[idx] + piow[idx] +
-                            pirq[idx] + psirq[idx] + psteal[idx];
-    unsigned long long dt = tot - pt;
-    unsigned long long di = idle - pi[idx];
-    double use = (dt > 0) ? (1.0 - (double)di / (double)dt) : 0.0;
-
-    if (initialized) {
-      if (idx == 0) {
-        cpu.total = use;
-      } else if (idx - 1 < MAX_CORES) {
-        cpu.core[idx - 1] = use;
-      }
+    // user nice system idle iowait irq softirq steal
+    unsigned long long v[8] = {0};
+    for (int k = 0; k < 8; k++) {
+      while (p < eol && *p == ' ')
+        p++;
+      v[k] = scan_ull(&p, eol);
+    }
+    unsigned long long tot = 0;
+    for (int k = 0; k < 8; k++)
+      tot += v[k];
+    unsigned long long idle = v[3];
+    unsigned long long cv[NCAT] = {v[0] + v[1], v[2] + v[5] + v[6], v[4],
+                                   v[7]};
+
+    unsigned long long dt = tick_delta(tot, ptot[idx]);
+    unsigned long long di = tick_delta(idle, pidle[idx]);
+    double use = (initialized && dt > 0 && di <= dt)
+                     ? (1.0 - (double)di / (double)dt)
+                     : 0.0;
+    for (int k = 0; k < NCAT; k++) {
+      cpu.cat[idx][k] =
+          initialized ? cat_frac(tick_delta(cv[k], pcat[idx][k]), dt) : 0;
+      pcat[idx][k] = cv[k];
+    }
+
+    if (idx == 0) {
+      cpu.total = use;
+      cpu.djiffies = initialized ? dt : 0;
+      cpu.jiffies = tot;
     } else {
-      if (idx == 0) {
-        cpu.total = 0.0;
-      } else if (idx - 1 < MAX_CORES) {
-        cpu.core[idx - 1] = 0.0;
-      }
+      cpu.core[idx - 1] = use;
+      if (idx > ncores)
+        ncores = idx;
     }
 
-    pu[idx] = u;
-    pn[idx] = n;
-    ps[idx] = s;
-    pi[idx] = idle;
-    piow[idx] = iow;
-    pirq[idx] = irq;
-    psirq[idx] = sirq;
-    psteal[idx] = steal;
-    idx++;
+    ptot[idx] = tot;
+    pidle[idx] = idle;
+    p = eol + 1;
   }
 
-  fclose(f);
   initialized = 1;
-  cpu.ncores = idx - 1;
+  // On a host whose cpu lines overflow procstat_buf the count falls back
+  // to the online CPUs.
+  if (cut && nstat < NCPU)
+    nstat = NCPU;
+  cpu.nstat = nstat > 0 ? nstat : 1;
+  cpu.ncores = ncores;
   if (cpu.ncores <= 0)
     cpu.ncores = 1;
   if (cpu.ncores > NCPU)
     cpu.ncores = NCPU;
   push_hist();
+  prof_add(&prof[PS_CPU], t0);
+}
+
+// ---------- History Store ----------
+// Long-range CPU/memory history lives in a fixed-size ring per resolution
+// (raw ticks, 10 s, 1 min, 10 min). With -s the rings and the rollup state
+// are an mmap'd file, so a later run picks up where the last one stopped;
+// without it they are an anonymous mapping of the same layout. Recording is
+// plain stores into the mapping: no allocation and no syscalls, the page
+// cache writes the file back. An entry is one 64-bit word (time, CPU, mem)
+// so the UI can read rings the sampler is writing without tearing.
+enum { HL_RAW = 0, HL_10S, HL_1M, HL_10M, HL_N };
+static const uint32_t hl_period[HL_N] = {0, 10, 60, 600};
+static const uint32_t hl_cap[HL_N] = {14400, 8640, 10080, 8640};
+static const char *const hl_name[HL_N] = {"raw", "10s", "1m", "10m"};
+
+#define HIST_MAGIC "NEOHIST1"
+
+typedef struct {
+  char magic[8];
+  uint32_t cap[HL_N];
+  _Atomic uint32_t head[HL_N]; // next slot to write
+  _Atomic uint32_t count[HL_N];
+  // Rollup buckets being accumulated; sampler-only.
+  uint32_t acc_bucket[HL_N];
+  uint32_t acc_n[HL_N];
+  uint64_t acc_cpu[HL_N], acc_mem[HL_N];
+} HistHdr;
+
+static HistHdr *hist_hdr = NULL;
+static _Atomic uint64_t *hist_ring[HL_N];
+static const char *hist_path = NULL;
+
+static size_t hist_bytes(void) {
+  size_t n = sizeof(HistHdr);
+  for (int l = 0; l < HL_N; l++)
+    n += hl_cap[l] * sizeof(uint64_t);
+  return n;
+}
+
+static bool hist_valid(const HistHdr *h) {
+  if (memcmp(h->magic, HIST_MAGIC, 8) != 0)
+    return false;
+  for (int l = 0; l < HL_N; l++) {
+    if (h->cap[l] != hl_cap[l] || atomic_load(&h->head[l]) >= hl_cap[l] ||
+        atomic_load(&h->count[l]) > hl_cap[l])
+      return false;
+  }
+  return true;
+}
+
+// Maps the store. Only a new or empty file is initialised, with its blocks
+// allocated up front so a full disk fails here rather than as SIGBUS in
+// hist_record(). Any other file must already hold a store of this layout,
+// or -s fails instead of overwriting it. The descriptor stays open for the
+// run to hold an exclusive flock(), so two instances never share a ring.
+static bool hist_open(void) {
+  size_t len = hist_bytes();
+  void *m = MAP_FAILED;
+  bool init = true;
+  if (hist_path) {
+    const char *why = NULL;
+    int fd = open(hist_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat st;
+    int e;
+    if (fd < 0 || fstat(fd, &st) != 0)
+      why = strerror(errno);
+    else if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+      why = errno == EWOULDBLOCK ? "in use by another neotop" : strerror(errno);
+    else if (st.st_size == 0 && (e = posix_fallocate(fd, 0, (off_t)len)) != 0)
+      why = strerror(e);
+    else if (st.st_size != 0 && (size_t)st.st_size != len)
+      why = "not a history store of this version";
+    if (!why) {
+      init = st.st_size == 0;
+      m = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (m == MAP_FAILED)
+        why = strerror(errno);
+      else if (!init && !hist_valid(m))
+        why = "not a history store of this version";
+    }
+    if (why) {
+      fprintf(stderr, "neotop: %s: %s\n", hist_path, why);
+      if (m != MAP_FAILED)
+        munmap(m, len);
+      if (fd >= 0)
+        close(fd);
+      return false;
+    }
+  } else {
+    m = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+             -1, 0);
+    if (m == MAP_FAILED)
+      return true; // no history this run, nothing else depends on it
+  }
+  hist_hdr = m;
+  char *p = (char *)m + sizeof(HistHdr);
+  for (int l = 0; l < HL_N; l++) {
+    hist_ring[l] = (_Atomic uint64_t *)(void *)p;
+    p += hl_cap[l] * sizeof(uint64_t);
+  }
+  if (init) {
+    memset(m, 0, len);
+    memcpy(hist_hdr->magic, HIST_MAGIC, 8);
+    for (int l = 0; l < HL_N; l++)
+      hist_hdr->cap[l] = hl_cap[l];
+  }
+  return true;
+}
+
+static uint64_t hist_pack(uint32_t t, double cpu_r, double mem_r) {
+  uint64_t c = (uint64_t)llround(fmin(fmax(cpu_r, 0.0), 1.0) * 10000);
+  uint64_t m = (uint64_t)llround(fmin(fmax(mem_r, 0.0), 1.0) * 10000);
+  return (uint64_t)t << 32 | c << 16 | m;
+}
+
+static void hist_put(int l, uint64_t e) {
+  HistHdr *h = hist_hdr;
+  uint32_t head = atomic_load_explicit(&h->head[l], memory_order_relaxed);
+  atomic_store_explicit(&hist_ring[l][head], e, memory_order_relaxed);
+  atomic_store_explicit(&h->head[l], (head + 1) % hl_cap[l],
+                        memory_order_release);
+  uint32_t c = atomic_load_explicit(&h->count[l], memory_order_relaxed);
+  if (c < hl_cap[l])
+    atomic_store_explicit(&h->count[l], c + 1, memory_order_release);
+}
+
+// Called after each CPU/memory tick.
+static void hist_record(void) {
+  if (!hist_hdr)
+    return;
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  uint32_t t = (uint32_t)ts.tv_sec;
+  double mem_r =
+      mem.total_kb ? (double)(mem.total_kb - mem.avail_kb) / mem.total_kb : 0;
+  uint64_t e = hist_pack(t, cpu.total, mem_r);
+  hist_put(HL_RAW, e);
+
+  HistHdr *h = hist_hdr;
+  for (int l = 1; l < HL_N; l++) {
+    uint32_t bucket = t / hl_period[l];
+    if (h->acc_n[l] && bucket != h->acc_bucket[l]) {
+      uint64_t n = h->acc_n[l];
+      uint64_t c = (h->acc_cpu[l] + n / 2) / n, m = (h->acc_mem[l] + n / 2) / n;
+      hist_put(l, (uint64_t)(h->acc_bucket[l] * hl_period[l]) << 32 |
+                      c << 16 | m);
+      h->acc_n[l] = 0;
+      h->acc_cpu[l] = h->acc_mem[l] = 0;
+    }
+    h->acc_bucket[l] = bucket;
+    h->acc_n[l]++;
+    h->acc_cpu[l] += e >> 16 & 0xffff;
+    h->acc_mem[l] += e & 0xffff;
+  }
+}
+
+// UI side: the i-th newest entry of level l, or 0 when there is none.
+static uint64_t hist_get(int l, uint32_t i) {
+  if (!hist_hdr)
+    return 0;
+  HistHdr *h = hist_hdr;
+  uint32_t head = atomic_load_explicit(&h->head[l], memory_order_acquire);
+  uint32_t count = atomic_load_explicit(&h->count[l], memory_order_acquire);
+  if (i >= count)
+    return 0;
+  uint32_t slot = (head + hl_cap[l] - 1 - i) % hl_cap[l];
+  return atomic_load_explicit(&hist_ring[l][slot], memory_order_relaxed);
+}
+
+static uint32_t hist_head(int l) {
+  return hist_hdr ? atomic_load(&hist_hdr->head[l]) : 0;
 }
 
 // ---------- Neofetch ----------
-static char neofetch_info[4096] = "";
+// `neofetch --stdout` can take seconds, so it never runs on the UI thread.
+// neofetch_load_cache() fills neofetch_info at startup from the last result
+// for this host and kernel; neofetch_start() refreshes it in a detached
+// thread that hands the text back through nf_result/nf_ready. It runs once,
+// at startup: adopting a result redraws the pages that show it, so a probe
+// started from a draw would start the next one. When neofetch is not
+// installed a native summary is built from what read_os_release(),
+// read_uname() and read_cpu_info() already collected.
+#define NF_MAX 4096
+static char neofetch_info[NF_MAX] = "";
+static char nf_result[NF_MAX];
+static atomic_bool nf_ready;
+
+// A text split at its newlines once, so pages print it line by line without
+// searching it on every draw.
+typedef struct {
+  const char *p;
+  int len;
+} TextLine;
+
+#define NF_LINES 64
+static TextLine nf_line[NF_LINES];
+static int nnf = 0;
+
+static int split_lines(TextLine *out, int max, const char *s) {
+  int n = 0;
+  for (const char *nl; n < max && (nl = strchr(s, '\n')); s = nl + 1)
+    out[n++] = (TextLine){s, (int)(nl - s)};
+  return n;
+}
 
-static void run_neofetch_stdout(void) {
-  neofetch_info[0] = 0;
-  FILE *fp = popen("neofetch --stdout 2>/dev/null", "r");
-  if (!fp)
+static bool nf_cache_path(char *out, size_t n) {
+  char dir[256];
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  if (xdg && *xdg)
+    snprintf(dir, sizeof(dir), "%s", xdg);
+  else if (home && *home)
+    snprintf(dir, sizeof(dir), "%s/.cache", home);
+  else
+    return false;
+  char key[256];
+  snprintf(key, sizeof(key), "%s-%s", host, kernel_rel);
+  for (char *p = key; *p; p++)
+    if (!isalnum((unsigned char)*p) && *p != '.' && *p != '-')
+      *p = '_';
+  int w = snprintf(out, n, "%s/neotop/neofetch-%s", dir, key);
+  return w > 0 && (size_t)w < n;
+}
+
+static void neofetch_load_cache(void) {
+  char path[576];
+  if (!nf_cache_path(path, sizeof(path)))
+    return;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+  ssize_t n = read_retry(fd, neofetch_info, sizeof(neofetch_info) - 1, -1);
+  neofetch_info[n > 0 ? n : 0] = '\0';
+  close(fd);
+  nnf = split_lines(nf_line, NF_LINES, neofetch_info);
+}
+
+static void nf_cache_store(const char *text, size_t len) {
+  char path[576], tmp[600];
+  if (!nf_cache_path(path, sizeof(path)))
     return;
+  char *slash = strrchr(path, '/');
+  *slash = '\0';
+  char *parent = strrchr(path, '/');
+  *parent = '\0';
+  mkdir(path, 0755);
+  *parent = '/';
+  mkdir(path, 0755);
+  *slash = '/';
+  snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+    return;
+  bool ok = write(fd, text, len) == (ssize_t)len;
+  close(fd);
+  if (!ok || rename(tmp, path) != 0)
+    unlink(tmp);
+}
+
+static size_t nf_native(char *out, size_t n) {
+  const char *user = getenv("USER");
+  const char *shell = getenv("SHELL");
+  int uh, um, us;
+  read_uptime(&uh, &um, &us);
+  long pages = sysconf(_SC_PHYS_PAGES), psz = sysconf(_SC_PAGESIZE);
+  long long mib = (pages > 0 && psz > 0) ? (long long)pages * psz >> 20 : 0;
+  int w = snprintf(out, n,
+                   "%s@%s\n"
+                   "OS: %s\n"
+                   "Kernel: %s\n"
+                   "Uptime: %dd %dh %dm\n"
+                   "Shell: %s\n"
+                   "CPU: %s (%d)\n"
+                   "Memory: %lld MiB\n",
+                   user ? user : "user", host, distro, kernel_rel, uh / 24,
+                   uh % 24, um, shell ? shell : "unknown", cpu_model, NCPU,
+                   mib);
+  return w < 0 ? 0 : ((size_t)w < n ? (size_t)w : n - 1);
+}
+
+static void *nf_main(void *arg) {
+  (void)arg;
   size_t pos = 0;
-  char line[256];
-  while (fgets(line, sizeof(line), fp) && pos < sizeof(neofetch_info) - 256) {
-    size_t len = strlen(line);
-    memcpy(neofetch_info + pos, line, len);
-    pos += len;
+  FILE *fp = popen("neofetch --stdout 2>/dev/null", "r");
+  if (fp) {
+    char line[256];
+    while (fgets(line, sizeof(line), fp) && pos < sizeof(nf_result) - 256) {
+      size_t len = strlen(line);
+      memcpy(nf_result + pos, line, len);
+      pos += len;
+    }
+    pclose(fp);
   }
-  neofetch_info[pos] = '\0';
-  pclose(fp);
+  nf_result[pos] = '\0';
+  if (pos > 0)
+    nf_cache_store(nf_result, pos);
+  else
+    nf_native(nf_result, sizeof(nf_result));
+  atomic_store(&nf_ready, true);
+  evfd_signal(ui_evfd);
+  return NULL;
+}
+
+static void neofetch_start(void) {
+  pthread_t t;
+  if (pthread_create(&t, NULL, nf_main, NULL) == 0)
+    pthread_detach(t);
+}
+
+// UI side: adopts a finished probe. True when neofetch_info changed.
+static bool neofetch_poll(void) {
+  if (!atomic_exchange(&nf_ready, false))
+    return false;
+  memcpy(neofetch_info, nf_result, sizeof(neofetch_info));
+  nnf = split_lines(nf_line, NF_LINES, neofetch_info);
+  return true;
 }
 
 static const char *pick_ascii_logo(const char *pretty) {
@@ -427,10 +1201,154 @@ static const char *pick_ascii_logo(const char *pretty) {
   return generic;
 }
 
+// ---------- System Info Model ----------
+// The System Information page prints this model and never probes the machine
+// while it draws. What cannot change while we run (the root device, the logo
+// lines, the battery files) is looked up once by sysi_init(). Storage,
+// network and battery are re-read by the sampler every SYSI_MS while the
+// page is up, without spawning df or ip, and published in the snapshot
+// together with the uptime.
+#define SYSI_MS 5000
+#define LOGO_LINES 8
+
+static TextLine logo_line[LOGO_LINES];
+static int nlogo = 0;
+static char root_dev[128] = "";
+
+enum { BAT_CAP, BAT_STATUS, BAT_HEALTH, NBAT };
+static const char *bat_file[NBAT] = {"capacity", "status", "health"};
+static int bat_fd[NBAT] = {-1, -1, -1};
+static int route_fd = -1;
+
+typedef struct {
+  long uptime_s;
+  unsigned gen; // bumped by every refresh of the fields below
+  bool fs_ok;
+  unsigned long long fs_total, fs_used, fs_avail; // bytes, counted as df does
+  int fs_pct;
+  char ip[INET_ADDRSTRLEN], iface[32], gw[INET_ADDRSTRLEN];
+  bool bat_ok;
+  int bat_cap;
+  char bat_status[32], bat_health[32];
+} SysDyn;
+static SysDyn sysd = {0};
+static long long sysi_next = 0; // now_ms() of the next slow refresh
+
+static void sysi_init(void) {
+  nlogo = split_lines(logo_line, LOGO_LINES, pick_ascii_logo(distro));
+  // The last mount on "/" is the one statvfs() reports on.
+  FILE *f = fopen("/proc/self/mountinfo", "r");
+  if (f) {
+    char line[512], mnt[256], dev[128];
+    while (fgets(line, sizeof(line), f)) {
+      const char *sep = strstr(line, " - ");
+      if (sep && sscanf(line, "%*s %*s %*s %*s %255s", mnt) == 1 &&
+          !strcmp(mnt, "/") && sscanf(sep + 3, "%*s %127s", dev) == 1)
+        snprintf(root_dev, sizeof(root_dev), "%s", dev);
+    }
+    fclose(f);
+  }
+  for (int i = 0; i < NBAT; i++) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/class/power_supply/BAT0/%s",
+             bat_file[i]);
+    bat_fd[i] = open(path, O_RDONLY | O_CLOEXEC);
+  }
+  route_fd = open("/proc/net/route", O_RDONLY | O_CLOEXEC);
+}
+
+static bool sysi_read_str(int fd, char *out, size_t n) {
+  ssize_t r = fd >= 0 ? read_retry(fd, out, n - 1, 0) : -1;
+  if (r <= 0)
+    return false;
+  out[r] = '\0';
+  out[strcspn(out, "\n")] = '\0';
+  return true;
+}
+
+// The default route's interface and gateway, from the first line whose
+// destination is 0.0.0.0. Addresses are hex in network byte order.
+static void sysi_route(void) {
+  char buf[4096];
+  snprintf(sysd.iface, sizeof(sysd.iface), "Unknown");
+  snprintf(sysd.gw, sizeof(sysd.gw), "Unknown");
+  ssize_t n = route_fd >= 0 ? read_retry(route_fd, buf, sizeof(buf) - 1, 0)
+                            : -1;
+  if (n <= 0)
+    return;
+  buf[n] = '\0';
+  for (char *l = strchr(buf, '\n'); l; l = strchr(l, '\n')) {
+    char name[32];
+    unsigned dst, gw;
+    l++;
+    if (sscanf(l, "%31s %x %x", name, &dst, &gw) == 3 && dst == 0) {
+      struct in_addr a = {.s_addr = gw};
+      snprintf(sysd.iface, sizeof(sysd.iface), "%s", name);
+      inet_ntop(AF_INET, &a, sysd.gw, sizeof(sysd.gw));
+      return;
+    }
+  }
+}
+
+// First IPv4 address outside 127/8, preferring the default interface.
+static void sysi_addr(void) {
+  struct ifaddrs *ifs;
+  snprintf(sysd.ip, sizeof(sysd.ip), "Not connected");
+  if (getifaddrs(&ifs) != 0)
+    return;
+  bool exact = false;
+  for (struct ifaddrs *i = ifs; i && !exact; i = i->ifa_next) {
+    if (!i->ifa_addr || i->ifa_addr->sa_family != AF_INET)
+      continue;
+    struct in_addr a = ((struct sockaddr_in *)i->ifa_addr)->sin_addr;
+    if (ntohl(a.s_addr) >> 24 == 127)
+      continue;
+    exact = !strcmp(i->ifa_name, sysd.iface);
+    if (exact || !isdigit((unsigned char)sysd.ip[0]))
+      inet_ntop(AF_INET, &a, sysd.ip, sizeof(sysd.ip));
+  }
+  freeifaddrs(ifs);
+}
+
+// Sampler side, on the sensor tick while the page is up.
+static void sysi_sample(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_BOOTTIME, &ts);
+  sysd.uptime_s = ts.tv_sec;
+  long long now = now_ms();
+  if (now < sysi_next)
+    return;
+  sysi_next = now + SYSI_MS;
+
+  struct statvfs vf;
+  sysd.fs_ok = statvfs("/", &vf) == 0 && vf.f_blocks;
+  if (sysd.fs_ok) {
+    unsigned long long fr = vf.f_frsize;
+    sysd.fs_total = vf.f_blocks * fr;
+    sysd.fs_used = (vf.f_blocks - vf.f_bfree) * fr;
+    sysd.fs_avail = vf.f_bavail * fr;
+    unsigned long long base = sysd.fs_used + sysd.fs_avail;
+    sysd.fs_pct = base ? (int)((sysd.fs_used * 100 + base - 1) / base) : 0;
+  }
+  sysi_route();
+  sysi_addr();
+
+  char cap[16];
+  sysd.bat_ok = sysi_read_str(bat_fd[BAT_CAP], cap, sizeof(cap)) &&
+                sysi_read_str(bat_fd[BAT_STATUS], sysd.bat_status,
+                              sizeof(sysd.bat_status));
+  sysd.bat_cap = sysd.bat_ok ? atoi(cap) : 0;
+  if (!sysi_read_str(bat_fd[BAT_HEALTH], sysd.bat_health,
+                     sizeof(sysd.bat_health)))
+    snprintf(sysd.bat_health, sizeof(sysd.bat_health), "Unknown");
+  sysd.gen++;
+}
+
 // ---------- Processes ----------
 typedef struct {
   pid_t pid;
   uid_t uid;
+  const char *user; // interned by uid_name(), never freed
   char comm[MAX_COMM];
   unsigned long ut, st;
   double cpu_pct;
@@ -438,331 +1356,4153 @@ typedef struct {
   int nicev;
   bool running;
   bool suspended_by_manager;
+  unsigned char cls; // CLS_* flags, see Name Matcher
+  unsigned char ext; // EXT_* rates below that are valid for this scan
+  int threads;
+  double rd_bps, wr_bps; // storage I/O, bytes/s
+  double csw_ps;         // voluntary + involuntary context switches/s
+  uint16_t grp;          // 1-based cgroup index while grouping, else 0
 } PInfo;
 
-static PInfo procs[MAX_PROCS];
+// Per-cgroup sums for one scan, indexed by PInfo.grp - 1. Groups without a
+// process in this scan have nproc 0.
+typedef struct {
+  const char *path; // interned, never freed
+  int nproc;
+  double cpu_pct;
+  unsigned long rss_kb;
+} GroupAgg;
+
+// Growable process tables. scan_processes() fills one that no published
+// snapshot references and then points `procs` at it, so a table is never
+// copied or cleared wholesale. The group sums travel with their table.
+typedef struct {
+  PInfo *v;
+  int n, cap;
+  GroupAgg *g;
+  int ng, gcap;
+} ProcBuf;
+
+static PInfo *procs = NULL;
 static int nprocs = 0;
-static long long gtot_prev = 0, gtot_cur = 0;
 
+// Written by the UI thread; the sampler reads them under mgr_lock.
+static pthread_mutex_t mgr_lock = PTHREAD_MUTEX_INITIALIZER;
 static char priority_procs[MAX_PRIORITY_PROCS][MAX_COMM];
 static int num_priority_procs = 0;
 static bool auto_manage_enabled = false;
 
-static int is_pid_dir(const char *s) {
-  for (; *s; s++)
-    if (!isdigit((unsigned char)*s))
-      return 0;
-  return 1;
-}
-
-static int read_comm(pid_t pid, char *out, size_t n) {
-  char p[64];
-  snprintf(p, sizeof(p), "/proc/%d/comm", pid);
-  FILE *f = fopen(p, "r");
-  if (!f)
-    return -1;
-  if (!fgets(out, n, f)) {
-    fclose(f);
+// ---------- /proc/<pid>/stat ----------
+// One openat()+read() of stat per PID, relative to a /proc dirfd opened once.
+// comm, state, utime, stime, nice, thread count, starttime and RSS all come
+// from that read; the owner UID comes from fstatat() on the PID directory.
+typedef struct {
+  char comm[MAX_COMM];
+  char state;
+  unsigned long ut, st;
+  int nicev;
+  int threads;
+  unsigned long long starttime;
+  unsigned long rss_pages;
+} StatSample;
+
+static int parse_stat(const char *buf, size_t len, StatSample *out) {
+  const char *end = buf + len;
+  const char *lp = memchr(buf, '(', len);
+  const char *rp = memrchr(buf, ')', len);
+  if (!lp || !rp || rp < lp || rp + 2 >= end)
     return -1;
-  }
-  out[strcspn(out, "\n")] = 0;
-  fclose(f);
+
+  size_t cl = (size_t)(rp - lp - 1);
+  if (cl >= sizeof(out->comm))
+    cl = sizeof(out->comm) - 1;
+  memcpy(out->comm, lp + 1, cl);
+  out->comm[cl] = 0;
+
+  // Field 3 (state) starts two bytes past the closing paren.
+  const char *p = rp + 2;
+  out->state = *p;
+  p = skip_fields(p, end, 11); // -> 14 utime
+  out->ut = (unsigned long)scan_ull(&p, end);
+  p = skip_fields(p, end, 1); // -> 15 stime
+  out->st = (unsigned long)scan_ull(&p, end);
+  p = skip_fields(p, end, 4); // -> 19 nice
+  out->nicev = (int)scan_ll(&p, end);
+  p = skip_fields(p, end, 1); // -> 20 num_threads
+  out->threads = (int)scan_ull(&p, end);
+  p = skip_fields(p, end, 2); // -> 22 starttime
+  out->starttime = scan_ull(&p, end);
+  p = skip_fields(p, end, 2); // -> 24 rss
+  out->rss_pages = (unsigned long)scan_ull(&p, end);
   return 0;
 }
 
-static int read_stat(pid_t pid, unsigned long *ut, unsigned long *st,
-                     int *nicev, bool *running) {
-  char p[64];
-  snprintf(p, sizeof(p), "/proc/%d/stat", pid);
-  FILE *f = fopen(p, "r");
-  if (!f)
+// Fallback for when fstatat() on the PID directory is refused.
+static int read_status_uid(int dfd, const char *name, uid_t *uid) {
+  char path[32];
+  snprintf(path, sizeof(path), "%s/status", name);
+  int fd = openat(dfd, path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
     return -1;
-  char line[1024];
-  if (!fgets(line, sizeof(line), f)) {
-    fclose(f);
+  char buf[1024];
+  ssize_t n = read_retry(fd, buf, sizeof(buf) - 1, -1);
+  close(fd);
+  if (n <= 0)
     return -1;
-  }
-  fclose(f);
-  char *rp = strrchr(line, ')');
-  if (!rp)
+  buf[n] = 0;
+  const char *u = strstr(buf, "\nUid:");
+  if (!u)
     return -1;
-  char *rest = rp + 2;
-  int field = 3;
-  char *save = rest, *tok;
-  *running = true;
-  while ((tok = strsep(&save, " "))) {
-    if (*tok == '\0')
-      continue;
-    if (field == 3) {
-      char st = tok[0];
-      *running = (st != 'T' && st != 'Z');
-    } else if (field == 14)
-      *ut = strtoul(tok, NULL, 10);
-    else if (field == 15)
-      *st = strtoul(tok, NULL, 10);
-    else if (field == 19) {
-      *nicev = (int)strtol(tok, NULL, 10);
-      break;
-    }
-    field++;
-  }
+  u += 5;
+  while (*u == '\t' || *u == ' ')
+    u++;
+  *uid = (uid_t)strtoul(u, NULL, 10);
   return 0;
 }
 
-static int read_status(pid_t pid, uid_t *uid, unsigned long *rss_kb) {
-  char p[64];
-  snprintf(p, sizeof(p), "/proc/%d/status", pid);
-  FILE *f = fopen(p, "r");
-  if (!f)
-    return -1;
-  char line[256];
-  *rss_kb = 0;
-  *uid = 0;
-  while (fgets(line, sizeof(line), f)) {
-    unsigned int u;
-    unsigned long v;
-    char unit[32];
-    if (sscanf(line, "Uid:\t%u", &u) == 1) {
-      *uid = (uid_t)u;
-      continue;
-    }
-    if (sscanf(line, "VmRSS:\t%lu %31s", &v, unit) == 2) {
-      *rss_kb = v;
-    }
+static void read_pid_uid(int dfd, const char *name, uid_t *uid) {
+  struct stat sb;
+  if (fstatat(dfd, name, &sb, 0) == 0) {
+    *uid = sb.st_uid;
+    return;
   }
-  fclose(f);
-  return 0;
+  if (read_status_uid(dfd, name, uid) < 0)
+    *uid = 0;
 }
 
-static const char *uname_from_uid(uid_t uid) {
-  struct passwd *pw = getpwuid(uid);
-  return pw ? pw->pw_name : "unknown";
+// ---------- User Names ----------
+// UID -> name cache filled by the sampler while merging a scan, so NSS (which
+// may mean an LDAP/SSSD round trip) is never consulted from the render path.
+// Names are interned in an append-only arena and published by pointer inside
+// PInfo; they stay valid for the life of the program. Entries expire after
+// UID_TTL_MS, and all of them when /etc/passwd changes.
+#define UID_TTL_MS (10 * 60 * 1000L)
+#define NAME_ARENA 4096
+
+typedef struct {
+  uid_t uid;
+  bool used;
+  long expires;
+  const char *name;
+} UidEnt;
+
+static UidEnt ucache[1024];
+static const char *name_set[1024];
+static char *name_arena = NULL;
+static size_t name_arena_left = 0;
+static struct timespec passwd_mtime;
+
+static const char *intern_name(const char *s) {
+  size_t len = strlen(s);
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++)
+    h = (h ^ (unsigned char)s[i]) * 16777619u;
+  size_t mask = sizeof(name_set) / sizeof(name_set[0]) - 1;
+  for (size_t n = 0, i = h & mask; n <= mask; n++, i = (i + 1) & mask) {
+    if (!name_set[i]) {
+      if (len + 1 > name_arena_left) {
+        size_t sz = len + 1 > NAME_ARENA ? len + 1 : NAME_ARENA;
+        name_arena = malloc(sz);
+        if (!name_arena)
+          return "unknown";
+        name_arena_left = sz;
+      }
+      char *d = name_arena;
+      memcpy(d, s, len + 1);
+      name_arena += len + 1;
+      name_arena_left -= len + 1;
+      name_set[i] = d;
+      return d;
+    }
+    if (!strcmp(name_set[i], s))
+      return name_set[i];
+  }
+  return "unknown"; // set full: thousands of distinct user names
 }
 
-static void read_cpu_totals(void) {
-  FILE *f = fopen("/proc/stat", "r");
-  if (!f)
-    return;
-  char buf[256];
-  if (!fgets(buf, sizeof(buf), f)) {
-    fclose(f);
+// Once per scan: drop every cached name if /etc/passwd changed.
+static void uid_cache_check(void) {
+  struct stat sb;
+  if (stat("/etc/passwd", &sb) != 0)
     return;
+  if (sb.st_mtim.tv_sec != passwd_mtime.tv_sec ||
+      sb.st_mtim.tv_nsec != passwd_mtime.tv_nsec) {
+    passwd_mtime = sb.st_mtim;
+    for (size_t i = 0; i < sizeof(ucache) / sizeof(ucache[0]); i++)
+      ucache[i].expires = 0;
+  }
+}
+
+static const char *uid_name(uid_t uid) {
+  size_t mask = sizeof(ucache) / sizeof(ucache[0]) - 1;
+  size_t i = ((uint32_t)uid * 2654435761u) & mask;
+  size_t n = 0;
+  while (ucache[i].used && ucache[i].uid != uid && n++ < mask)
+    i = (i + 1) & mask;
+  UidEnt *e = &ucache[i];
+  if (e->used && e->uid != uid)
+    return "unknown"; // table full
+  long t = now_ms();
+  if (e->used && t < e->expires)
+    return e->name;
+
+  char buf[1024];
+  struct passwd pw, *res = NULL;
+  const char *nm;
+  char num[16];
+  if (getpwuid_r(uid, &pw, buf, sizeof(buf), &res) == 0 && res) {
+    nm = res->pw_name;
+  } else {
+    snprintf(num, sizeof(num), "%u", (unsigned)uid);
+    nm = num;
+  }
+  e->uid = uid;
+  e->used = true;
+  e->expires = t + UID_TTL_MS;
+  e->name = intern_name(nm);
+  return e->name;
+}
+
+// ---------- PID Table ----------
+// Open-addressing (linear probe) table keyed by PID holding per-process state
+// that must survive between scans. Entries not seen in the latest scan are
+// evicted by ptab_sweep() using backward-shift deletion, so no tombstones.
+typedef struct {
+  pid_t pid; // 0 = empty slot
+  unsigned gen;
+  unsigned long ut, st;
+  unsigned long long starttime;
+  int fdslot; // 1-based index into fdc[], 0 = no cached descriptor
+  bool primed; // ut/st/starttime hold a previous sample
+  bool exited; // exit reported by the proc connector, awaiting sweep
+  bool suspended_by_manager;
+  unsigned char cg_group; // CG_* leaf the cgroup backend moved it to
+  uint16_t cg_origin;     // 1-based index into cg_origins[], 0 = unknown
+  unsigned char cls;      // CLS_* flags from the name matcher
+  unsigned cls_ver;       // matcher version cls was computed with
+  uint32_t comm_hash;     // FNV-1a of the comm cls was computed for
+  int row;                // index in the table of the scan that saw it
+  unsigned ext_gen;       // ptab_gen of the last extended-counter visit
+  unsigned char ext;      // EXT_* counters below hold a previous sample
+  unsigned long long io_rd, io_wr, csw;
+  long long io_ms, csw_ms; // when those were read
+  uint16_t grp;            // 1-based cgroup index, 0 = not read yet
+  float cpu_avg;           // policy: smoothed cpu_pct
+  unsigned char pol;       // POL_* step the manager holds it at
+  unsigned char over;      // scans in a row over the enter limits
+  unsigned char under;     // scans in a row under the exit limits
+  signed char pol_nice;    // nice before POL_RENICE
+} PEntry;
+
+static PEntry *ptab = NULL;
+static size_t ptab_cap = 0, ptab_len = 0;
+static unsigned ptab_gen = 0;
+static int n_suspended = 0;
+
+static inline size_t ptab_hash(pid_t pid) {
+  return ((uint32_t)pid * 2654435761u) & (ptab_cap - 1);
+}
+
+static PEntry *ptab_find(pid_t pid) {
+  if (!ptab_cap)
+    return NULL;
+  for (size_t i = ptab_hash(pid);; i = (i + 1) & (ptab_cap - 1)) {
+    if (ptab[i].pid == pid)
+      return &ptab[i];
+    if (ptab[i].pid == 0)
+      return NULL;
+  }
+}
+
+static void ptab_place(PEntry *tab, size_t cap, const PEntry *e) {
+  size_t i = ((uint32_t)e->pid * 2654435761u) & (cap - 1);
+  while (tab[i].pid != 0)
+    i = (i + 1) & (cap - 1);
+  tab[i] = *e;
+}
+
+static int ptab_grow(void) {
+  size_t ncap = ptab_cap ? ptab_cap * 2 : 1024;
+  PEntry *nt = calloc(ncap, sizeof(PEntry));
+  if (!nt)
+    return -1;
+  for (size_t i = 0; i < ptab_cap; i++)
+    if (ptab[i].pid != 0)
+      ptab_place(nt, ncap, &ptab[i]);
+  free(ptab);
+  ptab = nt;
+  ptab_cap = ncap;
+  return 0;
+}
+
+// Returns the entry for pid, inserting a zeroed one if absent. *fresh is set
+// when the entry did not exist before this call.
+static PEntry *ptab_get(pid_t pid, bool *fresh) {
+  PEntry *e = ptab_find(pid);
+  *fresh = (e == NULL);
+  if (e)
+    return e;
+  if ((ptab_len + 1) * 2 > ptab_cap && ptab_grow() < 0)
+    return NULL;
+  size_t i = ptab_hash(pid);
+  while (ptab[i].pid != 0)
+    i = (i + 1) & (ptab_cap - 1);
+  memset(&ptab[i], 0, sizeof(PEntry));
+  ptab[i].pid = pid;
+  ptab_len++;
+  return &ptab[i];
+}
+
+static void fdc_release(int slot);
+
+static void ptab_delete_at(size_t i) {
+  size_t mask = ptab_cap - 1;
+  size_t j = i;
+  if (ptab[i].fdslot)
+    fdc_release(ptab[i].fdslot);
+  if (ptab[i].suspended_by_manager)
+    n_suspended--;
+  ptab[i].pid = 0;
+  for (;;) {
+    j = (j + 1) & mask;
+    if (ptab[j].pid == 0)
+      break;
+    size_t home = ptab_hash(ptab[j].pid);
+    // Move j back into the hole at i unless its home lies cyclically in (i, j].
+    bool keep = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+    if (keep)
+      continue;
+    ptab[i] = ptab[j];
+    ptab[j].pid = 0;
+    i = j;
+  }
+  ptab_len--;
+}
+
+static void ptab_sweep(void) {
+  for (size_t i = 0; i < ptab_cap;) {
+    if (ptab[i].pid != 0 && ptab[i].gen != ptab_gen) {
+      ptab_delete_at(i);
+      continue; // slot i may now hold a shifted entry
+    }
+    i++;
+  }
+}
+
+// ---------- Stat Descriptor Cache ----------
+// With -f, /proc/<pid>/stat descriptors stay open across scans and are
+// re-sampled with pread(fd, ..., 0). Slots form an LRU list; the budget is
+// derived from RLIMIT_NOFILE so the cache never starves the rest of the
+// program of descriptors.
+#define FD_RESERVE 64
+
+typedef struct {
+  int fd;
+  pid_t pid;
+  unsigned gen; // ptab_gen of the last successful read
+  int prev, next;
+} FdSlot;
+
+static bool persist_fds = false;
+static FdSlot *fdc = NULL;
+static int fdc_cap = 0, fdc_used = 0;
+static int fdc_head = -1, fdc_tail = -1, fdc_free = -1;
+// Free slots left for the descriptors scan workers open this scan. It is
+// reset before each scan and a worker only keeps a descriptor it reserved
+// here, so -f never holds more open than the cache can adopt.
+static _Atomic int fdc_spare = 0;
+
+static void fdc_init(void) {
+  struct rlimit rl;
+  if (getrlimit(RLIMIT_NOFILE, &rl) != 0)
+    return;
+  if (rl.rlim_cur < rl.rlim_max) {
+    rlim_t want = rl.rlim_max;
+    if (want == RLIM_INFINITY || want > 1 << 20)
+      want = 1 << 20;
+    struct rlimit nrl = {want, rl.rlim_max};
+    if (setrlimit(RLIMIT_NOFILE, &nrl) == 0)
+      rl.rlim_cur = want;
+  }
+  // The sensor files are already held open and come out of the budget.
+  rlim_t reserve = FD_RESERVE + (rlim_t)sens_nfds;
+  if (rl.rlim_cur <= reserve * 2)
+    fdc_cap = (int)(rl.rlim_cur / 2);
+  else
+    fdc_cap = (int)(rl.rlim_cur - reserve);
+  fdc = calloc((size_t)fdc_cap, sizeof(FdSlot));
+  if (!fdc) {
+    fdc_cap = 0;
+    return;
+  }
+  for (int i = 0; i < fdc_cap; i++) {
+    fdc[i].fd = -1;
+    fdc[i].next = (i + 1 < fdc_cap) ? i + 1 : -1;
+  }
+  fdc_free = fdc_cap ? 0 : -1;
+}
+
+static void fdc_unlink(int i) {
+  FdSlot *s = &fdc[i];
+  if (s->prev >= 0)
+    fdc[s->prev].next = s->next;
+  else
+    fdc_head = s->next;
+  if (s->next >= 0)
+    fdc[s->next].prev = s->prev;
+  else
+    fdc_tail = s->prev;
+}
+
+static void fdc_push_front(int i) {
+  fdc[i].prev = -1;
+  fdc[i].next = fdc_head;
+  if (fdc_head >= 0)
+    fdc[fdc_head].prev = i;
+  fdc_head = i;
+  if (fdc_tail < 0)
+    fdc_tail = i;
+}
+
+static void fdc_touch(int slot) {
+  int i = slot - 1;
+  fdc[i].gen = ptab_gen;
+  if (fdc_head != i) {
+    fdc_unlink(i);
+    fdc_push_front(i);
+  }
+}
+
+static void fdc_release(int slot) {
+  int i = slot - 1;
+  close(fdc[i].fd);
+  fdc[i].fd = -1;
+  fdc_unlink(i);
+  fdc[i].next = fdc_free;
+  fdc_free = i;
+  fdc_used--;
+}
+
+// Takes ownership of fd. Returns the new slot, or 0 if the descriptor was
+// closed because the budget is exhausted.
+static int fdc_adopt(pid_t pid, int fd) {
+  if (fdc_free < 0 && fdc_tail >= 0 && fdc[fdc_tail].gen + 1 < ptab_gen) {
+    // Evict the least recently used descriptor, but only if it sat idle for
+    // a whole scan; otherwise a table larger than the budget would thrash.
+    int victim = fdc_tail;
+    PEntry *owner = ptab_find(fdc[victim].pid);
+    if (owner)
+      owner->fdslot = 0;
+    fdc_release(victim + 1);
+  }
+  if (fdc_free < 0) {
+    close(fd);
+    return 0;
+  }
+  int i = fdc_free;
+  fdc_free = fdc[i].next;
+  fdc[i].fd = fd;
+  fdc[i].pid = pid;
+  fdc[i].gen = ptab_gen;
+  fdc_push_front(i);
+  fdc_used++;
+  return i + 1;
+}
+
+static PInfo *pbuf_push(ProcBuf *b) {
+  if (b->n == b->cap) {
+    int ncap = b->cap ? b->cap * 2 : 512;
+    PInfo *nv = realloc(b->v, (size_t)ncap * sizeof(PInfo));
+    if (!nv)
+      return NULL;
+    b->v = nv;
+    b->cap = ncap;
+  }
+  return &b->v[b->n];
+}
+
+// ---------- Proc Connector Backend ----------
+// With -n the PID set is maintained from kernel proc connector events
+// (fork/exec/exit) instead of re-listing /proc each scan; only the startup
+// scan, and any scan after the event socket overflowed, walks the directory.
+// Taskstats exit records credit CPU burnt by processes that exited between
+// scans, which a sampling collector cannot otherwise see.
+typedef struct {
+  bool active;
+  int spawned, exited; // during the last scan interval
+  double exited_cpu_pct;
+} ChurnStats;
+
+static bool use_netlink = false;
+static int pcn_fd = -1, ts_fd = -1;
+static uint16_t ts_family = 0;
+static bool pcn_resync = true;
+static int pcn_spawned = 0, pcn_exited = 0;
+static double pcn_exit_ticks = 0.0;
+static time_t last_scan_wall = 0;
+static ChurnStats churn = {0};
+
+static int pcn_open(void) {
+  int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  NETLINK_CONNECTOR);
+  if (fd < 0)
+    return -1;
+  struct sockaddr_nl sa = {.nl_family = AF_NETLINK,
+                           .nl_groups = CN_IDX_PROC,
+                           .nl_pid = (uint32_t)getpid()};
+  if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  char buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))]
+      __attribute__((aligned(NLMSG_ALIGNTO)));
+  memset(buf, 0, sizeof(buf));
+  struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+  nlh->nlmsg_len =
+      NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op));
+  nlh->nlmsg_type = NLMSG_DONE;
+  nlh->nlmsg_pid = (uint32_t)getpid();
+  struct cn_msg *cn = NLMSG_DATA(nlh);
+  cn->id.idx = CN_IDX_PROC;
+  cn->id.val = CN_VAL_PROC;
+  cn->len = sizeof(enum proc_cn_mcast_op);
+  enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+  memcpy(cn->data, &op, sizeof(op));
+  if (send(fd, buf, nlh->nlmsg_len, 0) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static int genl_send(int fd, uint16_t type, uint8_t cmd, uint16_t attr,
+                     const void *data, int len) {
+  struct {
+    struct nlmsghdr n;
+    struct genlmsghdr g;
+    char buf[256];
+  } req;
+  memset(&req, 0, sizeof(req));
+  req.n.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+  req.n.nlmsg_type = type;
+  req.n.nlmsg_flags = NLM_F_REQUEST;
+  req.n.nlmsg_pid = (uint32_t)getpid();
+  req.g.cmd = cmd;
+  req.g.version = 1;
+  struct nlattr *na = (struct nlattr *)((char *)&req + req.n.nlmsg_len);
+  na->nla_type = attr;
+  na->nla_len = (uint16_t)(NLA_HDRLEN + len);
+  memcpy((char *)na + NLA_HDRLEN, data, (size_t)len);
+  req.n.nlmsg_len += NLA_ALIGN(na->nla_len);
+  struct sockaddr_nl sa = {.nl_family = AF_NETLINK};
+  return sendto(fd, &req, req.n.nlmsg_len, 0, (struct sockaddr *)&sa,
+                sizeof(sa)) < 0
+             ? -1
+             : 0;
+}
+
+static int ts_open(void) {
+  int fd = socket(PF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+  if (fd < 0)
+    return -1;
+  struct timeval tv = {.tv_sec = 1};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  if (genl_send(fd, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, CTRL_ATTR_FAMILY_NAME,
+                TASKSTATS_GENL_NAME, sizeof(TASKSTATS_GENL_NAME)) < 0)
+    goto fail;
+
+  char buf[4096] __attribute__((aligned(NLMSG_ALIGNTO)));
+  ssize_t n = recv(fd, buf, sizeof(buf), 0);
+  struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+  if (n <= 0 || !NLMSG_OK(nlh, (size_t)n) || nlh->nlmsg_type == NLMSG_ERROR)
+    goto fail;
+  int alen = (int)nlh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+  struct nlattr *na = (struct nlattr *)((char *)NLMSG_DATA(nlh) + GENL_HDRLEN);
+  while (alen >= NLA_HDRLEN && na->nla_len >= NLA_HDRLEN) {
+    if (na->nla_type == CTRL_ATTR_FAMILY_ID)
+      memcpy(&ts_family, (char *)na + NLA_HDRLEN, sizeof(ts_family));
+    alen -= NLA_ALIGN(na->nla_len);
+    na = (struct nlattr *)((char *)na + NLA_ALIGN(na->nla_len));
+  }
+  if (!ts_family)
+    goto fail;
+
+  char mask[32];
+  snprintf(mask, sizeof(mask), "0-%d", NCPU - 1);
+  if (genl_send(fd, ts_family, TASKSTATS_CMD_GET,
+                TASKSTATS_CMD_ATTR_REGISTER_CPUMASK, mask,
+                (int)strlen(mask) + 1) < 0)
+    goto fail;
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+
+fail:
+  close(fd);
+  return -1;
+}
+
+static void pcn_init(void) {
+  pcn_fd = pcn_open();
+  if (pcn_fd < 0) {
+    fprintf(stderr, "neotop: proc connector unavailable (%s), using /proc "
+                    "scan\n",
+            strerror(errno));
+    use_netlink = false;
+    return;
+  }
+  ts_fd = ts_open(); // optional: without it exited CPU stays 0
+  churn.active = true;
+}
+
+// A fork into a PID the table still holds: the old process exited and its
+// entry awaits the sweep. It is reset to look like a fresh insert, as a
+// starttime mismatch in scan_account() does, except that the cached
+// descriptor belonged to the dead process and is dropped.
+static void pcn_reused(PEntry *pe) {
+  pid_t pid = pe->pid;
+  if (pe->fdslot)
+    fdc_release(pe->fdslot);
+  if (pe->suspended_by_manager)
+    n_suspended--;
+  memset(pe, 0, sizeof(*pe));
+  pe->pid = pid;
+}
+
+static void pcn_drain_events(void) {
+  char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+  for (;;) {
+    ssize_t n = recv(pcn_fd, buf, sizeof(buf), 0);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == ENOBUFS) {
+        pcn_resync = true; // events were dropped; re-list /proc once
+        continue;
+      }
+      break;
+    }
+    size_t len = (size_t)n;
+    for (struct nlmsghdr *nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, len);
+         nlh = NLMSG_NEXT(nlh, len)) {
+      struct cn_msg *cn = NLMSG_DATA(nlh);
+      if (cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC)
+        continue;
+      struct proc_event *ev = (struct proc_event *)cn->data;
+      bool fresh;
+      PEntry *pe;
+      switch (ev->what) {
+      case PROC_EVENT_FORK:
+        if (ev->event_data.fork.child_pid != ev->event_data.fork.child_tgid)
+          break; // new thread, not a new process
+        pe = ptab_get(ev->event_data.fork.child_tgid, &fresh);
+        if (pe && !fresh)
+          pcn_reused(pe);
+        pcn_spawned++;
+        break;
+      case PROC_EVENT_EXIT:
+        if (ev->event_data.exit.process_pid !=
+            ev->event_data.exit.process_tgid)
+          break;
+        pe = ptab_find(ev->event_data.exit.process_tgid);
+        if (pe)
+          pe->exited = true;
+        pcn_exited++;
+        break;
+      default:
+        break;
+      }
+    }
+  }
+}
+
+static void ts_credit(const struct taskstats *ts, size_t len) {
+  uint32_t tgid = ts->ac_pid;
+  if (len >= offsetof(struct taskstats, ac_tgid) + sizeof(ts->ac_tgid))
+    tgid = ts->ac_tgid;
+  double total =
+      (double)(ts->ac_utime + ts->ac_stime) * ticks_per_sec / 1000000.0;
+  PEntry *pe = ptab_find((pid_t)tgid);
+  if (pe && pe->primed) {
+    double seen = (double)(pe->ut + pe->st);
+    if (total > seen)
+      pcn_exit_ticks += total - seen;
+  } else if ((time_t)ts->ac_btime + 1 >= last_scan_wall) {
+    pcn_exit_ticks += total; // born and died between two scans
+  }
+}
+
+static void ts_drain(void) {
+  char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+  for (;;) {
+    ssize_t n = recv(ts_fd, buf, sizeof(buf), 0);
+    if (n < 0) {
+      if (errno == EINTR || errno == ENOBUFS)
+        continue;
+      break;
+    }
+    size_t len = (size_t)n;
+    for (struct nlmsghdr *nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, len);
+         nlh = NLMSG_NEXT(nlh, len)) {
+      if (nlh->nlmsg_type != ts_family)
+        continue;
+      // A message carries AGGR_PID for the exiting thread and, when a whole
+      // thread group goes away, AGGR_TGID as well; prefer the group total.
+      const struct taskstats *pid_ts = NULL, *tgid_ts = NULL;
+      size_t pid_len = 0, tgid_len = 0;
+      int alen = (int)nlh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+      struct nlattr *na =
+          (struct nlattr *)((char *)NLMSG_DATA(nlh) + GENL_HDRLEN);
+      while (alen >= NLA_HDRLEN && na->nla_len >= NLA_HDRLEN) {
+        if (na->nla_type == TASKSTATS_TYPE_AGGR_PID ||
+            na->nla_type == TASKSTATS_TYPE_AGGR_TGID) {
+          int ilen = na->nla_len - NLA_HDRLEN;
+          struct nlattr *in = (struct nlattr *)((char *)na + NLA_HDRLEN);
+          while (ilen >= NLA_HDRLEN && in->nla_len >= NLA_HDRLEN) {
+            if (in->nla_type == TASKSTATS_TYPE_STATS) {
+              const struct taskstats *t =
+                  (const struct taskstats *)((char *)in + NLA_HDRLEN);
+              size_t tl = (size_t)(in->nla_len - NLA_HDRLEN);
+              if (na->nla_type == TASKSTATS_TYPE_AGGR_TGID) {
+                tgid_ts = t;
+                tgid_len = tl;
+              } else {
+                pid_ts = t;
+                pid_len = tl;
+              }
+            }
+            ilen -= NLA_ALIGN(in->nla_len);
+            in = (struct nlattr *)((char *)in + NLA_ALIGN(in->nla_len));
+          }
+        }
+        alen -= NLA_ALIGN(na->nla_len);
+        na = (struct nlattr *)((char *)na + NLA_ALIGN(na->nla_len));
+      }
+      if (tgid_ts)
+        ts_credit(tgid_ts, tgid_len);
+      else if (pid_ts && pid_len >= offsetof(struct taskstats, ac_utime) +
+                                        2 * sizeof(pid_ts->ac_utime)) {
+        bool leader =
+            pid_len < offsetof(struct taskstats, ac_tgid) +
+                          sizeof(pid_ts->ac_tgid) ||
+            pid_ts->ac_pid == pid_ts->ac_tgid;
+        if (leader)
+          ts_credit(pid_ts, pid_len);
+      }
+    }
+  }
+}
+
+// ---------- Self Usage ----------
+// neotop's own footprint since the previous call, summed over all of its
+// threads: CPU from the process CPU clock, RSS from /proc/self/statm, and
+// syscall and byte counts from /proc/self/io (syscr + syscw, rchar), which
+// the kernel maintains anyway.
+typedef struct {
+  ProfStat stage[NPS];
+  double cpu_pct; // of one core
+  unsigned long rss_kb;
+  unsigned long long syscalls, read_bytes;
+  long interval_ms;
+  int nprocs;
+  bool valid; // false until two calls have been made
+} ProfSnap;
+
+static ssize_t self_read(const char *path, int *fd, char *buf, size_t n) {
+  if (*fd < 0) {
+    *fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (*fd < 0)
+      return -1;
+  }
+  ssize_t len = read_retry(*fd, buf, n - 1, 0);
+  if (len >= 0)
+    buf[len] = '\0';
+  return len;
+}
+
+static unsigned long long io_field(const char *buf, const char *key) {
+  const char *p = strstr(buf, key);
+  if (!p)
+    return 0;
+  p += strlen(key);
+  while (*p == ' ')
+    p++;
+  return scan_ull(&p, p + 24);
+}
+
+static void prof_collect(ProfSnap *ps) {
+  static int io_fd = -1, statm_fd = -1;
+  static long long prev_wall, prev_cpu;
+  static unsigned long long prev_sc, prev_rb;
+  char buf[512];
+
+  for (int i = 0; i < NPS; i++)
+    ps->stage[i] = prof_stat(&prof[i]);
+  ps->nprocs = nprocs;
+
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  long long cpu_ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+  long long wall = now_ns();
+  unsigned long long sc = 0, rb = 0;
+  if (self_read("/proc/self/io", &io_fd, buf, sizeof(buf)) > 0) {
+    sc = io_field(buf, "syscr:") + io_field(buf, "syscw:");
+    rb = io_field(buf, "rchar:");
+  }
+  if (self_read("/proc/self/statm", &statm_fd, buf, sizeof(buf)) > 0) {
+    const char *p = buf;
+    while (*p && *p != ' ')
+      p++;
+    while (*p == ' ')
+      p++;
+    ps->rss_kb = (unsigned long)scan_ull(&p, p + 24) * (unsigned long)page_kb;
+  }
+
+  ps->valid = prev_wall != 0 && wall > prev_wall;
+  if (ps->valid) {
+    ps->interval_ms = (long)((wall - prev_wall) / 1000000);
+    ps->cpu_pct =
+        (double)(cpu_ns - prev_cpu) * 100.0 / (double)(wall - prev_wall);
+    ps->syscalls = sc - prev_sc;
+    ps->read_bytes = rb - prev_rb;
+  }
+  prev_wall = wall;
+  prev_cpu = cpu_ns;
+  prev_sc = sc;
+  prev_rb = rb;
+}
+
+// ---------- Thread Rows ----------
+// One line of the thread page. The sampler keeps the current pass in
+// thr_cur, sorted by CPU and cut to THR_MAX; see Thread Sampling.
+#define THR_MAX 512
+
+typedef struct {
+  pid_t tid;
+  char name[16];
+  char state;
+  int nicev;
+  int cpu_last; // field 39: the CPU the thread last ran on
+  double cpu_pct;
+  unsigned long long ticks; // utime + stime so far
+} ThreadRow;
+
+static ThreadRow thr_cur[THR_MAX];
+static int thr_ncur = 0, thr_total = 0;
+static pid_t thr_cur_pid = 0;
+static bool thr_live = false; // the thread page is up; sampler-private
+static bool thr_gone = false; // the process has no task directory any more
+
+// ---------- Sampling Cadence ----------
+// The process scan is the expensive collector, so its interval adapts. A
+// PID set that stayed the same for CAD_STABLE scans doubles it, for twice
+// that many scans quadruples it, and an unfocused terminal (xterm focus
+// reports) stretches it and the /proc/stat tick by CAD_UNFOCUSED. CPU or
+// memory use above CAD_HOT, or a resource manager that is holding
+// processes back, brings it down to half the base so the manager reacts
+// quickly. A fixed interval picked with [ and ] (or -t) overrides all of
+// it.
+#define CAD_STABLE 5
+#define CAD_UNFOCUSED 4
+#define CAD_HOT 0.90
+#define CAD_MAX_MS 12000
+#define KEY_FOCUS_IN (KEY_MAX + 1) // keycodes bound to the focus reports
+#define KEY_FOCUS_OUT (KEY_MAX + 2)
+
+static const long cad_steps[] = {250, 500, 1000, 1500, 3000, 5000, 10000};
+#define NCAD_STEPS (int)(sizeof(cad_steps) / sizeof(cad_steps[0]))
+
+static atomic_long cad_fixed;         // fixed scan interval; 0 = adaptive
+static atomic_bool ui_focused = true; // from terminal focus reports
+static long cad_cpu_cur = 0, cad_proc_cur = 0; // armed intervals, 0 = off
+static int cad_stable = 0; // consecutive scans with an unchanged PID set
+static uint64_t cad_set = 0;
+static bool mgr_engaged = false; // set by manage_resources()
+
+// The PID set as an order-independent sum, compared scan to scan.
+static void cad_note_scan(void) {
+  uint64_t set = (uint64_t)nprocs;
+  for (int i = 0; i < nprocs; i++)
+    set += (uint64_t)procs[i].pid * 0x9e3779b97f4a7c15ull;
+  cad_stable = set == cad_set ? cad_stable + 1 : 0;
+  cad_set = set;
+}
+
+static long cad_cpu_ms(void) {
+  return atomic_load(&ui_focused) ? CPU_MS : CPU_MS * CAD_UNFOCUSED;
+}
+
+static long cad_proc_ms(void) {
+  long fixed = atomic_load(&cad_fixed);
+  if (fixed > 0)
+    return fixed;
+  unsigned long mt = mem.total_kb;
+  double mem_used = mt ? (double)(mt - mem.avail_kb) / mt : 0.0;
+  if (cpu.total >= CAD_HOT || mem_used >= CAD_HOT || mgr_engaged)
+    return PROC_MS / 2;
+  long ms = PROC_MS;
+  if (cad_stable >= 2 * CAD_STABLE)
+    ms *= 4;
+  else if (cad_stable >= CAD_STABLE)
+    ms *= 2;
+  if (!atomic_load(&ui_focused))
+    ms *= CAD_UNFOCUSED;
+  return ms < CAD_MAX_MS ? ms : CAD_MAX_MS;
+}
+
+// Called by the UI with the interval it last saw in use: dir < 0 picks the
+// next shorter step, dir > 0 the next longer one, 0 goes back to adaptive.
+static void cad_step(int dir, long in_use) {
+  if (!dir) {
+    atomic_store(&cad_fixed, 0);
+    return;
+  }
+  long cur = atomic_load(&cad_fixed);
+  if (!cur)
+    cur = in_use ? in_use : PROC_MS;
+  long next = dir < 0 ? cad_steps[0] : cad_steps[NCAD_STEPS - 1];
+  for (int i = 0; i < NCAD_STEPS; i++) {
+    long v = cad_steps[dir < 0 ? NCAD_STEPS - 1 - i : i];
+    if (dir < 0 ? v < cur : v > cur) {
+      next = v;
+      break;
+    }
+  }
+  atomic_store(&cad_fixed, next);
+}
+
+// ---------- Snapshots ----------
+// The sampler thread publishes immutable snapshots through a lock-free triple
+// buffer: it fills snaps[snap_back] and swaps it into snap_mid; the UI swaps
+// its front slot with snap_mid whenever SNAP_NEW is set. Process tables are
+// shared between snapshots by pointer and recycled only once none of the
+// three slots references them.
+#define SNAP_NEW 4u
+#define NTABS 4
+
+typedef struct {
+  CpuSnap cpu;
+  MemSnap mem;
+  SensorSnap sens;
+  PsiSnap psi;
+  SysDyn sysd;
+  CoreHist hist;
+  ChurnStats churn;
+  ProfSnap prof; // filled only while prof_on
+  const ThreadRow *thr; // nthr rows in this slot's own storage
+  int nthr, thr_total;
+  pid_t thr_pid;
+  bool thr_gone;
+  const ProcBuf *tab;
+  unsigned long tab_seq;
+  int nsuspended;
+  long scan_ms; // armed process scan interval, 0 while not scanning
+  const char *host; // -C: the daemon shown (interned, or its address)
+  bool host_up;     // -C: that daemon's stream is live
+  unsigned long seq;
+} Snapshot;
+
+static const char *remote_host = NULL; // receiver-private, see remote_main()
+static bool remote_up = false;
+
+static Snapshot snaps[3];
+static ThreadRow thr_store[3][THR_MAX];
+static _Atomic unsigned snap_mid = 1;
+static int snap_back = 0;  // sampler-private
+static int snap_front = 2; // UI-private
+static ProcBuf tabs[NTABS];
+static ProcBuf *cur_tab = NULL;
+static unsigned long tab_seq = 0;
+
+static ProcBuf *tab_acquire(void) {
+  // The slots other than snap_back are snap_mid and the UI's front; the UI may
+  // swap them at any time, but never rewrites a slot, so reading both is safe.
+  const ProcBuf *busy[3] = {cur_tab, NULL, NULL};
+  for (int i = 0, k = 1; i < 3; i++)
+    if (i != snap_back)
+      busy[k++] = snaps[i].tab;
+  for (int i = 0; i < NTABS; i++) {
+    if (&tabs[i] != busy[0] && &tabs[i] != busy[1] && &tabs[i] != busy[2])
+      return &tabs[i];
+  }
+  return NULL;
+}
+
+static void snap_publish(void) {
+  Snapshot *s = &snaps[snap_back];
+  s->cpu = cpu;
+  s->mem = mem;
+  s->sens = sens;
+  s->psi = psi;
+  s->sysd = sysd;
+  s->hist = core_hist;
+  s->churn = churn;
+  if (atomic_load(&prof_on))
+    prof_collect(&s->prof);
+  // Thread rows are copied only while the thread page is up.
+  s->nthr = 0;
+  if (thr_live) {
+    memcpy(thr_store[snap_back], thr_cur, (size_t)thr_ncur * sizeof(ThreadRow));
+    s->nthr = thr_ncur;
+  }
+  s->thr = thr_store[snap_back];
+  s->thr_total = thr_total;
+  s->thr_pid = thr_cur_pid;
+  s->thr_gone = thr_gone;
+  s->tab = cur_tab;
+  s->tab_seq = tab_seq;
+  s->nsuspended = n_suspended;
+  s->scan_ms = cad_proc_cur;
+  s->host = remote_host;
+  s->host_up = remote_up;
+  s->seq++;
+  unsigned prev = atomic_exchange(&snap_mid, (unsigned)snap_back | SNAP_NEW);
+  snap_back = (int)(prev & 3u);
+  evfd_signal(ui_evfd);
+}
+
+static const Snapshot *snap_latest(void) {
+  if (atomic_load(&snap_mid) & SNAP_NEW) {
+    unsigned prev = atomic_exchange(&snap_mid, (unsigned)snap_front);
+    snap_front = (int)(prev & 3u);
+  }
+  return &snaps[snap_front];
+}
+
+// ---------- Process Scan ----------
+// A scan runs in three phases: the sampler lists PIDs (one getdents64 pass,
+// or the PID table in -n mode) into ScanItems, the items are sharded across
+// the scan workers for the stat read and parse, and the sampler then merges
+// the results into the PID table and the next process table in list order.
+// Workers only touch their own items, so the first and last phases need no
+// locking.
+typedef struct {
+  pid_t pid;
+  int slot;  // fdc slot of the cached descriptor, 0 = none
+  int fd;    // that descriptor, or -1
+  int newfd; // descriptor opened by the worker for the cache, or -1
+  bool stale; // the cached descriptor's task is gone (ESRCH/ENOENT)
+  bool ok;
+  uid_t uid;
+  StatSample ss;
+} ScanItem;
+
+typedef struct {
+  ProcBuf *out;
+  double span_ticks;
+  int dfd;
+  bool groups; // read cgroups and sum them per group
+} ScanCtx;
+
+struct linux_dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+static ScanItem *items = NULL;
+static int nitems = 0, items_cap = 0;
+
+static void item_push(PEntry *pe) {
+  if (nitems == items_cap) {
+    int ncap = items_cap ? items_cap * 2 : 512;
+    ScanItem *nv = realloc(items, (size_t)ncap * sizeof(ScanItem));
+    if (!nv)
+      return;
+    items = nv;
+    items_cap = ncap;
+  }
+  ScanItem *it = &items[nitems++];
+  it->pid = pe->pid;
+  it->slot = pe->fdslot;
+  it->fd = pe->fdslot ? fdc[pe->fdslot - 1].fd : -1;
+}
+
+static int collect_proc_dir(int dfd) {
+  int lfd = openat(dfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (lfd < 0)
+    return -1;
+  char buf[32768] __attribute__((aligned(8)));
+  for (;;) {
+    long n = syscall(SYS_getdents64, lfd, buf, sizeof(buf));
+    if (n <= 0)
+      break;
+    for (long off = 0; off < n;) {
+      struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+      off += d->d_reclen;
+      const char *nm = d->d_name;
+      if ((unsigned)(*nm - '1') >= 9)
+        continue;
+      pid_t pid = 0;
+      while ((unsigned)(*nm - '0') < 10)
+        pid = pid * 10 + (*nm++ - '0');
+      if (*nm)
+        continue;
+      bool fresh;
+      PEntry *pe = ptab_get(pid, &fresh);
+      if (pe)
+        item_push(pe);
+    }
+  }
+  close(lfd);
+  return 0;
+}
+
+// Event-driven variant: the PID table already holds every live process.
+static void collect_known_pids(void) {
+  for (size_t i = 0; i < ptab_cap; i++)
+    if (ptab[i].pid != 0 && !ptab[i].exited)
+      item_push(&ptab[i]);
+}
+
+// ---------- Cgroup Groups ----------
+// The grouped process view needs each process's cgroup. It is read from
+// /proc/<pid>/cgroup once, when the PID entry is first seen (or on the
+// first scan after grouping was switched on), and kept in the entry as an
+// index into an interned path table, so steady-state scans cost no extra
+// opens. The cgroup v2 path is used; on a hybrid host whose unified tree is
+// flat, the memory controller's v1 path stands in, which is where container
+// runtimes place pods. Per-group sums are added up as each process is
+// accounted.
+//
+// With -g the scan itself is limited to one cgroup subtree: the PID list
+// comes from the cgroup.procs files below it instead of a /proc walk.
+#define GRP_MAX 4096
+#define GRP_DEPTH 32
+
+static atomic_bool grp_on; // set by the UI while the grouped view is up
+static const char *grp_path[GRP_MAX];
+static uint16_t grp_slot[GRP_MAX * 2]; // path hash -> 1-based index
+static int grp_n = 0;
+static const char *scope_path = NULL;
+static int scope_fd = -1;
+
+// The last slot collects everything once the table is full.
+static uint16_t grp_intern(const char *path) {
+  size_t len = strlen(path);
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++)
+    h = (h ^ (unsigned char)path[i]) * 16777619u;
+  size_t mask = GRP_MAX * 2 - 1;
+  for (size_t i = h & mask;; i = (i + 1) & mask) {
+    uint16_t k = grp_slot[i];
+    if (k && !strcmp(grp_path[k - 1], path))
+      return k;
+    if (!k) {
+      char *dup = grp_n < GRP_MAX - 1 ? strdup(path) : NULL;
+      if (!dup)
+        break;
+      grp_path[grp_n++] = dup;
+      grp_slot[i] = (uint16_t)grp_n;
+      return (uint16_t)grp_n;
+    }
+  }
+  if (!grp_path[GRP_MAX - 1])
+    grp_path[GRP_MAX - 1] = "(other)";
+  return GRP_MAX;
+}
+
+static uint16_t grp_of(int dfd, pid_t pid) {
+  char path[32], buf[2048];
+  snprintf(path, sizeof(path), "%d/cgroup", (int)pid);
+  int fd = openat(dfd, path, O_RDONLY | O_CLOEXEC);
+  ssize_t n = fd < 0 ? -1 : read_retry(fd, buf, sizeof(buf) - 1, -1);
+  if (fd >= 0)
+    close(fd);
+  if (n <= 0)
+    return grp_intern("?");
+  buf[n] = '\0';
+
+  // hierarchy-ID:controller-list:path, one line per hierarchy
+  const char *v2 = NULL, *v1mem = NULL;
+  for (char *p = buf; *p;) {
+    char *eol = strchr(p, '\n');
+    if (eol)
+      *eol = '\0';
+    char *c1 = strchr(p, ':'), *c2 = c1 ? strchr(c1 + 1, ':') : NULL;
+    if (c2) {
+      *c2 = '\0';
+      if (c2 == c1 + 1 && !strcmp(p, "0"))
+        v2 = c2 + 1;
+      else if (strstr(c1 + 1, "memory"))
+        v1mem = c2 + 1;
+    }
+    if (!eol)
+      break;
+    p = eol + 1;
+  }
+  const char *cg = v2 && strcmp(v2, "/") ? v2 : v1mem ? v1mem : v2;
+  return grp_intern(cg ? cg : "?");
+}
+
+static void group_account(int dfd, ProcBuf *b, PEntry *pe, PInfo *p) {
+  if (!pe->grp)
+    pe->grp = grp_of(dfd, pe->pid);
+  int k = pe->grp;
+  if (k > b->ng) {
+    if (k > b->gcap) {
+      GroupAgg *ng = realloc(b->g, (size_t)GRP_MAX * sizeof(GroupAgg));
+      if (!ng)
+        return;
+      b->g = ng;
+      b->gcap = GRP_MAX;
+    }
+    memset(b->g + b->ng, 0, (size_t)(k - b->ng) * sizeof(GroupAgg));
+    b->ng = k;
+  }
+  GroupAgg *g = &b->g[k - 1];
+  g->path = grp_path[k - 1];
+  g->nproc++;
+  g->cpu_pct += p->cpu_pct;
+  g->rss_kb += p->rss_kb;
+  p->grp = (uint16_t)k;
+}
+
+static void scope_push(pid_t pid) {
+  bool fresh;
+  PEntry *pe = pid > 0 ? ptab_get(pid, &fresh) : NULL;
+  if (pe)
+    item_push(pe);
+}
+
+// Lists the PIDs of one cgroup and, recursively, of every cgroup below it.
+static void collect_cgroup(int cfd, int depth) {
+  char buf[32768] __attribute__((aligned(8)));
+  int fd = openat(cfd, "cgroup.procs", O_RDONLY | O_CLOEXEC);
+  if (fd >= 0) {
+    pid_t pid = 0;
+    ssize_t n;
+    // Numbers may straddle two reads, so the parse state carries over.
+    while ((n = read_retry(fd, buf, sizeof(buf), -1)) > 0) {
+      for (ssize_t i = 0; i < n; i++) {
+        if ((unsigned)(buf[i] - '0') < 10) {
+          pid = pid * 10 + (buf[i] - '0');
+        } else {
+          scope_push(pid);
+          pid = 0;
+        }
+      }
+    }
+    scope_push(pid);
+    close(fd);
+  }
+  if (depth >= GRP_DEPTH)
+    return;
+  int lfd = openat(cfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (lfd < 0)
+    return;
+  long n;
+  while ((n = syscall(SYS_getdents64, lfd, buf, sizeof(buf))) > 0) {
+    for (long off = 0; off < n;) {
+      struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+      off += d->d_reclen;
+      if (d->d_type != DT_DIR || d->d_name[0] == '.')
+        continue;
+      int sub = openat(lfd, d->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (sub >= 0) {
+        collect_cgroup(sub, depth + 1);
+        close(sub);
+      }
+    }
+  }
+  close(lfd);
+}
+
+// A path that is not a directory as given ("/system.slice" or
+// "kubepods.slice") is taken relative to CG_ROOT.
+static bool scope_open(const char *path) {
+  scope_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (scope_fd < 0) {
+    char full[PATH_MAX];
+    snprintf(full, sizeof(full), "/sys/fs/cgroup%s%s",
+             path[0] == '/' ? "" : "/", path);
+    scope_fd = open(full, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  }
+  return scope_fd >= 0;
+}
+
+// Runs on scan workers: touches nothing shared besides reading persist_fds
+// and reserving from fdc_spare.
+static void scan_item_io(int dfd, ScanItem *it) {
+  char buf[1024];
+  ssize_t n = -1;
+  it->ok = false;
+  it->stale = false;
+  it->newfd = -1;
+  if (it->fd >= 0) {
+    n = read_retry(it->fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0)
+      it->stale = true; // the PID may already belong to a new process
+  }
+  if (n <= 0) {
+    char path[32];
+    snprintf(path, sizeof(path), "%d/stat", it->pid);
+    int fd = openat(dfd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return;
+    n = read_retry(fd, buf, sizeof(buf) - 1, -1);
+    if (n > 0 && persist_fds && atomic_fetch_sub(&fdc_spare, 1) > 0)
+      it->newfd = fd;
+    else
+      close(fd);
+    if (n <= 0)
+      return;
+  }
+  buf[n] = 0;
+  if (parse_stat(buf, (size_t)n, &it->ss) < 0) {
+    if (it->newfd >= 0) {
+      close(it->newfd);
+      it->newfd = -1;
+    }
+    return;
+  }
+  char name[16];
+  snprintf(name, sizeof(name), "%d", it->pid);
+  read_pid_uid(dfd, name, &it->uid);
+  it->ok = true;
+}
+
+// ---------- Scan Workers ----------
+// -j N splits the per-PID reads of a scan across N threads, the sampler
+// being one of them. The default is a small fraction of the CPU count.
+static int scan_threads = 0;
+static int nworkers = 0; // helper threads besides the sampler
+static pthread_t *workers = NULL;
+static pthread_mutex_t pool_mx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static unsigned pool_gen = 0, pool_base = 0; // gen the workers start from
+static int pool_busy = 0, pool_dfd = -1;
+static bool pool_quit = false;
+
+static void run_shard(int k, int nshards) {
+  int lo = (int)((long long)nitems * k / nshards);
+  int hi = (int)((long long)nitems * (k + 1) / nshards);
+  for (int i = lo; i < hi; i++)
+    scan_item_io(pool_dfd, &items[i]);
+}
+
+static void *worker_main(void *arg) {
+  int k = (int)(intptr_t)arg;
+  unsigned seen = pool_base;
+  pthread_mutex_lock(&pool_mx);
+  for (;;) {
+    while (pool_gen == seen && !pool_quit)
+      pthread_cond_wait(&pool_cv, &pool_mx);
+    if (pool_quit)
+      break;
+    seen = pool_gen;
+    pthread_mutex_unlock(&pool_mx);
+    run_shard(k, nworkers + 1);
+    pthread_mutex_lock(&pool_mx);
+    if (--pool_busy == 0)
+      pthread_cond_signal(&pool_done);
+  }
+  pthread_mutex_unlock(&pool_mx);
+  return NULL;
+}
+
+static void pool_start(void) {
+  pool_quit = false;
+  pool_base = pool_gen;
+  int n = scan_threads > 0 ? scan_threads : NCPU / 8;
+  if (n < 1)
+    n = 1;
+  if (n > 64)
+    n = 64;
+  if (n == 1)
+    return;
+  workers = calloc((size_t)(n - 1), sizeof(pthread_t));
+  if (!workers)
+    return;
+  for (int i = 0; i < n - 1; i++) {
+    if (pthread_create(&workers[i], NULL, worker_main,
+                       (void *)(intptr_t)(i + 1)) != 0)
+      break;
+    nworkers++;
+  }
+}
+
+static void pool_stop(void) {
+  pthread_mutex_lock(&pool_mx);
+  pool_quit = true;
+  pthread_cond_broadcast(&pool_cv);
+  pthread_mutex_unlock(&pool_mx);
+  for (int i = 0; i < nworkers; i++)
+    pthread_join(workers[i], NULL);
+  free(workers);
+  workers = NULL;
+  nworkers = 0;
+}
+
+static void pool_run(int dfd) {
+  pool_dfd = dfd;
+  // Waking the pool costs more than reading a handful of PIDs inline.
+  if (nworkers == 0 || nitems < 64) {
+    run_shard(0, 1);
+    return;
+  }
+  pthread_mutex_lock(&pool_mx);
+  pool_busy = nworkers;
+  pool_gen++;
+  pthread_cond_broadcast(&pool_cv);
+  pthread_mutex_unlock(&pool_mx);
+  run_shard(0, nworkers + 1);
+  pthread_mutex_lock(&pool_mx);
+  while (pool_busy > 0)
+    pthread_cond_wait(&pool_done, &pool_mx);
+  pthread_mutex_unlock(&pool_mx);
+}
+
+// ---------- Name Matcher ----------
+// The priority list and the built-in system-critical list are compiled into
+// one Aho-Corasick automaton, rebuilt by the sampler only when the list or
+// the match mode changes, so classifying a comm is one pass over its bytes.
+// Bytes that occur in no pattern share alphabet class 0. By default both
+// lists match as substrings, as they always have. In exact mode (-x, or 'M'
+// on the Resource Manager page) a priority name must equal the comm and a
+// critical name must start it, so "X" no longer covers every comm with an X.
+enum { CLS_PRIO = 1, CLS_CRIT = 2 };
+
+static const char *critical_names[] = {
+    "systemd", "init", "kernel", "kthread", "ksoftirq", "kworker", "Xorg", "X",
+    "wayland", "sway", "gnome-shell", "kwin", "mutter", "plasmashell", "xfwm4",
+    "openbox", "i3", "dwm", "awesome", "gdm", "sddm", "lightdm", "login",
+    "getty", "pulseaudio", "pipewire", "wireplumber", "alsa", "NetworkManager",
+    "wpa_supplicant", "dhclient", "dhcpcd", "dbus", "dbus-daemon", "systemd-",
+    "udevd", "upowerd", "polkitd", "rtkit", "accounts-daemon", "udisksd",
+    "bluetoothd", "cupsd", "avahi", "ssh", "sshd", "cron", "crond", "atd",
+    "rsyslogd", "syslog", "journald", "dockerd", "containerd", "kubelet",
+    "libvirtd", "virtlogd", "qemu", "xfce4-session", "mate-session",
+    "cinnamon-session", "lxsession", "lxqt-session", "gnome-session",
+    "kde-session", NULL};
+
+typedef struct {
+  uint16_t *go;        // nstates x nclass, failure transitions folded in
+  uint16_t *depth;     // trie depth; off the trie path when it lags the input
+  unsigned char *out;  // flags of every pattern ending here (fail chain too)
+  unsigned char *term; // flags of priority names ending exactly here
+  unsigned char *pfx;  // flags of critical names ending exactly here
+  int nstates, nclass;
+  unsigned char cls_of[256];
+  bool exact;
+  unsigned ver; // match_ver this was built from
+} Matcher;
+
+static Matcher matcher;
+static bool match_exact = false; // under mgr_lock
+static unsigned match_ver = 1;   // under mgr_lock; bumped on every change
+
+static void matcher_free(Matcher *m) {
+  free(m->go);
+  free(m->depth);
+  free(m->out);
+  free(m->term);
+  free(m->pfx);
+}
+
+static void ac_insert(Matcher *m, const char *pat, unsigned char *mark,
+                      unsigned char flag) {
+  int st = 0;
+  for (const unsigned char *c = (const unsigned char *)pat; *c; c++) {
+    uint16_t *next = &m->go[st * m->nclass + m->cls_of[*c]];
+    if (!*next) {
+      *next = (uint16_t)m->nstates;
+      m->depth[m->nstates++] = (uint16_t)(m->depth[st] + 1);
+    }
+    st = *next;
+  }
+  if (st) {
+    mark[st] |= flag;
+    m->out[st] |= flag;
+  }
+}
+
+// Called with mgr_lock held. Keeps the old automaton if allocation fails.
+static void matcher_build(void) {
+  const char *pats[MAX_PRIORITY_PROCS + 128];
+  int npri = 0, n = 0;
+  for (int i = 0; i < num_priority_procs; i++)
+    pats[n++] = priority_procs[i];
+  npri = n;
+  for (int i = 0; critical_names[i]; i++)
+    pats[n++] = critical_names[i];
+
+  Matcher m = {.nclass = 1, .exact = match_exact, .ver = match_ver};
+  size_t maxst = 1;
+  for (int i = 0; i < n; i++) {
+    for (const unsigned char *c = (const unsigned char *)pats[i]; *c; c++)
+      if (!m.cls_of[*c])
+        m.cls_of[*c] = (unsigned char)m.nclass++;
+    maxst += strlen(pats[i]);
+  }
+  if (maxst > UINT16_MAX)
+    return;
+  m.go = calloc(maxst * (size_t)m.nclass, sizeof(*m.go));
+  m.depth = calloc(maxst, sizeof(*m.depth));
+  m.out = calloc(maxst, 1);
+  m.term = calloc(maxst, 1);
+  m.pfx = calloc(maxst, 1);
+  uint16_t *fail = calloc(maxst, sizeof(*fail));
+  uint16_t *queue = calloc(maxst, sizeof(*queue));
+  if (!m.go || !m.depth || !m.out || !m.term || !m.pfx || !fail || !queue) {
+    matcher_free(&m);
+    free(fail);
+    free(queue);
+    return;
+  }
+  m.nstates = 1;
+  for (int i = 0; i < n; i++)
+    ac_insert(&m, pats[i], i < npri ? m.term : m.pfx,
+              i < npri ? CLS_PRIO : CLS_CRIT);
+
+  // Breadth-first, so a state's failure target is final before its own
+  // children are visited. Missing edges borrow the failure state's edge,
+  // which turns the trie into a DFA; the root's missing edges loop to 0.
+  int qh = 0, qt = 0;
+  for (int c = 0; c < m.nclass; c++)
+    if (m.go[c])
+      queue[qt++] = m.go[c];
+  while (qh < qt) {
+    int st = queue[qh++];
+    m.out[st] |= m.out[fail[st]];
+    uint16_t *row = &m.go[st * m.nclass];
+    const uint16_t *frow = &m.go[fail[st] * m.nclass];
+    for (int c = 0; c < m.nclass; c++) {
+      if (row[c]) {
+        fail[row[c]] = frow[c];
+        queue[qt++] = row[c];
+      } else {
+        row[c] = frow[c];
+      }
+    }
+  }
+  free(fail);
+  free(queue);
+  matcher_free(&matcher);
+  matcher = m;
+}
+
+static unsigned char match_comm(const char *comm) {
+  const Matcher *m = &matcher;
+  const unsigned char *c = (const unsigned char *)comm;
+  unsigned st = 0, flags = 0;
+  if (!m->nstates)
+    return 0;
+  if (!m->exact) {
+    for (; *c; c++) {
+      st = m->go[st * m->nclass + m->cls_of[*c]];
+      flags |= m->out[st];
+    }
+    return (unsigned char)flags;
+  }
+  for (unsigned d = 1; *c; c++, d++) {
+    st = m->go[st * m->nclass + m->cls_of[*c]];
+    if (m->depth[st] != d)
+      return (unsigned char)flags; // fell off the trie path from the root
+    flags |= m->pfx[st];
+  }
+  return (unsigned char)(flags | m->term[st]);
+}
+
+// Sampler side, once per scan.
+static void matcher_sync(void) {
+  pthread_mutex_lock(&mgr_lock);
+  if (matcher.ver != match_ver)
+    matcher_build();
+  pthread_mutex_unlock(&mgr_lock);
+}
+
+// Reuses the entry's cached flags unless the comm or the automaton changed.
+// A new comm usually means an exec, which is also when launchers move a
+// process to its own cgroup, so the cached group is dropped too.
+static unsigned char classify(PEntry *pe, const char *comm) {
+  uint32_t h = 2166136261u;
+  for (const unsigned char *c = (const unsigned char *)comm; *c; c++)
+    h = (h ^ *c) * 16777619u;
+  if (pe->comm_hash != h)
+    pe->grp = 0;
+  if (pe->cls_ver != matcher.ver || pe->comm_hash != h) {
+    pe->cls = match_comm(comm);
+    pe->cls_ver = matcher.ver;
+    pe->comm_hash = h;
+  }
+  return pe->cls;
+}
+
+// ---------- Scan Merge ----------
+static void scan_merge_fd(PEntry *pe, ScanItem *it) {
+  // Only trust it->slot if the entry still owns it; fdc_adopt() for an
+  // earlier item may have evicted it.
+  if (it->slot && pe->fdslot == it->slot) {
+    if (it->stale) {
+      fdc_release(it->slot);
+      pe->fdslot = 0;
+    } else if (it->ok) {
+      fdc_touch(it->slot);
+    }
+  }
+  if (it->newfd >= 0) {
+    if (pe->fdslot == 0)
+      pe->fdslot = fdc_adopt(pe->pid, it->newfd);
+    else
+      close(it->newfd);
+  }
+}
+
+static void scan_account(ScanCtx *c, PEntry *pe, const ScanItem *it) {
+  PInfo *p = pbuf_push(c->out);
+  if (!p)
+    return;
+  const StatSample *ss = &it->ss;
+
+  *p = (PInfo){.pid = pe->pid,
+               .uid = it->uid,
+               .user = uid_name(it->uid),
+               .ut = ss->ut,
+               .st = ss->st,
+               .rss_kb = ss->rss_pages * (unsigned long)page_kb,
+               .nicev = ss->nicev,
+               .threads = ss->threads,
+               .running = (ss->state != 'T' && ss->state != 'Z')};
+  memcpy(p->comm, ss->comm, sizeof(p->comm));
+
+  if (pe->primed && pe->starttime != ss->starttime) {
+    // PID was reused by a new process since the last scan.
+    pid_t pid = pe->pid;
+    int slot = pe->fdslot;
+    if (pe->suspended_by_manager)
+      n_suspended--;
+    memset(pe, 0, sizeof(*pe));
+    pe->pid = pid;
+    pe->fdslot = slot;
+  }
+  if (pe->primed) {
+    unsigned long dut = (p->ut > pe->ut) ? (p->ut - pe->ut) : 0;
+    unsigned long dst = (p->st > pe->st) ? (p->st - pe->st) : 0;
+    p->cpu_pct = (c->span_ticks > 0)
+                     ? ((double)(dut + dst) * 100.0 / c->span_ticks)
+                     : 0.0;
+    p->suspended_by_manager = pe->suspended_by_manager;
+  }
+  pe->ut = p->ut;
+  pe->st = p->st;
+  p->cls = classify(pe, p->comm);
+  pe->starttime = ss->starttime;
+  pe->primed = true;
+  pe->gen = ptab_gen;
+  pe->row = c->out->n;
+  if (c->groups)
+    group_account(c->dfd, c->out, pe, p);
+  c->out->n++;
+}
+
+// Expects cpu_sample() to have run just before, so that cpu.jiffies matches
+// the moment the per-PID counters are read.
+static void scan_processes(void) {
+  static long long prev_time_ms = 0;
+  static unsigned long long prev_jiffies = 0;
+
+  int dfd = proc_root_fd();
+  if (dfd < 0)
+    return;
+
+  long long t0 = now_ns();
+  long long curr_time_ms = now_ms();
+  long long time_diff_ms =
+      (prev_time_ms > 0) ? (curr_time_ms - prev_time_ms) : 1500;
+
+  // Elapsed ticks of one CPU since the last scan: the aggregate /proc/stat
+  // delta spread over all cores, the same clock the CPU graphs use. The
+  // divisor counts every CPU line, not the MAX_CORES the graphs keep. Wall
+  // time is only the fallback before two samples exist.
+  double span_ticks = (double)time_diff_ms * ticks_per_sec / 1000.0;
+  if (prev_jiffies && cpu.jiffies > prev_jiffies)
+    span_ticks = (double)(cpu.jiffies - prev_jiffies) /
+                 (cpu.nstat > 0 ? cpu.nstat : 1);
+
+  ScanCtx c = {.out = tab_acquire(),
+               .span_ticks = span_ticks,
+               .dfd = dfd,
+               .groups = atomic_load(&grp_on)};
+  if (!c.out)
+    return;
+  c.out->n = 0;
+  c.out->ng = 0;
+  nitems = 0;
+  ptab_gen++;
+
+  if (pcn_fd >= 0) {
+    pcn_drain_events();
+    if (ts_fd >= 0)
+      ts_drain();
+  }
+  if (scope_fd >= 0) {
+    collect_cgroup(scope_fd, 0);
+  } else if (pcn_fd >= 0 && !pcn_resync) {
+    collect_known_pids();
+  } else {
+    if (collect_proc_dir(dfd) < 0)
+      return;
+    pcn_resync = false;
+  }
+
+  long long tp = now_ns();
+  atomic_store(&fdc_spare, fdc_cap - fdc_used);
+  pool_run(dfd);
+  prof_add(&prof[PS_PIDS], tp);
+  uid_cache_check();
+  matcher_sync();
+
+  for (int i = 0; i < nitems; i++) {
+    ScanItem *it = &items[i];
+    PEntry *pe = ptab_find(it->pid);
+    if (!pe) {
+      if (it->newfd >= 0)
+        close(it->newfd);
+      continue;
+    }
+    scan_merge_fd(pe, it);
+    if (it->ok)
+      scan_account(&c, pe, it);
+  }
+  cur_tab = c.out;
+  tab_seq++;
+  procs = c.out->v;
+  nprocs = c.out->n;
+
+  if (pcn_fd >= 0) {
+    churn.spawned = pcn_spawned;
+    churn.exited = pcn_exited;
+    churn.exited_cpu_pct =
+        (span_ticks > 0) ? pcn_exit_ticks * 100.0 / span_ticks : 0.0;
+    pcn_spawned = pcn_exited = 0;
+    pcn_exit_ticks = 0.0;
+  }
+
+  ptab_sweep();
+  prev_time_ms = curr_time_ms;
+  prev_jiffies = cpu.jiffies;
+  last_scan_wall = time(NULL);
+  prof_add(&prof[PS_SCAN], t0);
+}
+
+static void set_suspended(PInfo *p, bool on) {
+  p->suspended_by_manager = on;
+  PEntry *pe = ptab_find(p->pid);
+  if (pe && pe->suspended_by_manager != on) {
+    pe->suspended_by_manager = on;
+    n_suspended += on ? 1 : -1;
+  }
+}
+
+// ---------- Extended Counters ----------
+// Storage I/O from /proc/<pid>/io and context switches from
+// /proc/<pid>/status cost two more opens and reads per PID. They are
+// sampled only while the process page shows them, and only for the rows
+// the UI reports as on screen, the EXT_TOPK busiest by CPU and the next
+// EXT_SWEEP rows of a cursor that rotates over the whole table, so a scan
+// pays for at most EXT_WANT_MAX + EXT_TOPK + EXT_SWEEP of them. The sweep
+// is what lets a quiet-on-CPU process that hammers the disk get a reading,
+// reach the screen under an I/O sort, and stay sampled from then on. Rates
+// come from the previous reading kept in the PID entry, over however long
+// ago that was.
+#define EXT_WANT_MAX 256
+#define EXT_TOPK 32
+#define EXT_SWEEP 64
+
+enum { EXT_IO = 1, EXT_CSW = 2 };
+
+static atomic_bool ext_cols; // set by the UI while the columns are shown
+static pthread_mutex_t ext_lock = PTHREAD_MUTEX_INITIALIZER;
+static pid_t ext_want[EXT_WANT_MAX]; // under ext_lock
+static int ext_nwant = 0;             // under ext_lock
+static int ext_cursor = 0;            // sampler-private
+
+static unsigned long long kv_field(const char *buf, const char *key,
+                                   bool *found) {
+  const char *p = strstr(buf, key);
+  if (!p)
+    return 0;
+  p += strlen(key);
+  while (*p == ' ' || *p == '\t')
+    p++;
+  *found = true;
+  return scan_ull(&p, p + 24);
+}
+
+static bool pid_read(int dfd, pid_t pid, const char *file, char *buf,
+                     size_t n) {
+  char path[32];
+  snprintf(path, sizeof(path), "%d/%s", (int)pid, file);
+  int fd = openat(dfd, path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  ssize_t len = read_retry(fd, buf, n - 1, -1);
+  close(fd);
+  if (len <= 0)
+    return false;
+  buf[len] = '\0';
+  return true;
+}
+
+static double ext_rate(unsigned long long now, unsigned long long prev,
+                       long long dt_ms) {
+  return now >= prev && dt_ms > 0 ? (double)(now - prev) * 1000.0 / dt_ms
+                                  : 0.0;
+}
+
+static void ext_sample_one(int dfd, PEntry *pe, PInfo *p, long long t) {
+  char buf[4096];
+  bool f1 = false, f2 = false;
+  if (pid_read(dfd, p->pid, "io", buf, sizeof(buf))) {
+    unsigned long long rd = kv_field(buf, "\nread_bytes:", &f1);
+    unsigned long long wr = kv_field(buf, "\nwrite_bytes:", &f2);
+    if (f1 && f2) {
+      if (pe->ext & EXT_IO) {
+        p->rd_bps = ext_rate(rd, pe->io_rd, t - pe->io_ms);
+        p->wr_bps = ext_rate(wr, pe->io_wr, t - pe->io_ms);
+        p->ext |= EXT_IO;
+      }
+      pe->io_rd = rd;
+      pe->io_wr = wr;
+      pe->io_ms = t;
+      pe->ext |= EXT_IO;
+    }
+  }
+  f1 = f2 = false;
+  if (pid_read(dfd, p->pid, "status", buf, sizeof(buf))) {
+    unsigned long long v = kv_field(buf, "\nvoluntary_ctxt_switches:", &f1);
+    unsigned long long nv =
+        kv_field(buf, "\nnonvoluntary_ctxt_switches:", &f2);
+    if (f1 && f2) {
+      if (pe->ext & EXT_CSW) {
+        p->csw_ps = ext_rate(v + nv, pe->csw, t - pe->csw_ms);
+        p->ext |= EXT_CSW;
+      }
+      pe->csw = v + nv;
+      pe->csw_ms = t;
+      pe->ext |= EXT_CSW;
+    }
+  }
+}
+
+static void ext_visit(int dfd, ProcBuf *tab, pid_t pid, long long t) {
+  PEntry *pe = ptab_find(pid);
+  if (!pe || pe->gen != ptab_gen || pe->ext_gen == ptab_gen ||
+      pe->row >= tab->n)
+    return;
+  pe->ext_gen = ptab_gen;
+  ext_sample_one(dfd, pe, &tab->v[pe->row], t);
+}
+
+// Runs on the sampler after scan_processes(), before the table is
+// published, so the rows can still be filled in.
+static void ext_sample(void) {
+  ProcBuf *tab = cur_tab;
+  int dfd = proc_root_fd();
+  if (!tab || dfd < 0)
+    return;
+  long long t = now_ms();
+
+  // The top EXT_TOPK rows by CPU, kept sorted in a small array.
+  int top[EXT_TOPK], ntop = 0;
+  for (int i = 0; i < tab->n; i++) {
+    double c = tab->v[i].cpu_pct;
+    if (ntop == EXT_TOPK && c <= tab->v[top[ntop - 1]].cpu_pct)
+      continue;
+    int j = ntop < EXT_TOPK ? ntop++ : ntop - 1;
+    while (j > 0 && tab->v[top[j - 1]].cpu_pct < c) {
+      top[j] = top[j - 1];
+      j--;
+    }
+    top[j] = i;
+  }
+  for (int i = 0; i < ntop; i++)
+    ext_visit(dfd, tab, tab->v[top[i]].pid, t);
+  for (int i = 0; i < EXT_SWEEP && i < tab->n; i++) {
+    if (ext_cursor >= tab->n)
+      ext_cursor = 0;
+    ext_visit(dfd, tab, tab->v[ext_cursor++].pid, t);
+  }
+
+  pid_t want[EXT_WANT_MAX];
+  pthread_mutex_lock(&ext_lock);
+  int nwant = ext_nwant;
+  memcpy(want, ext_want, (size_t)nwant * sizeof(pid_t));
+  pthread_mutex_unlock(&ext_lock);
+  for (int i = 0; i < nwant; i++)
+    ext_visit(dfd, tab, want[i], t);
+}
+
+// ---------- Thread Sampling ----------
+// The thread page reads /proc/<pid>/task/*/stat for the one process it
+// shows, every THREAD_MS while it is up and never otherwise. A thread's
+// CPU% is its utime+stime delta since the previous pass over wall-clock
+// ticks, the same figure scan_processes() computes per process. Previous
+// samples are kept sorted by TID and matched with a binary search.
+typedef struct {
+  pid_t tid;
+  unsigned long long ticks, start;
+} ThrPrev;
+
+static atomic_int thr_pid; // set by the UI on entering the page
+static ThreadRow *thr_all = NULL;  // every thread of the current pass
+static ThrPrev *thr_prev = NULL;   // the previous pass, by TID
+static ThrPrev *thr_next = NULL;   // becomes thr_prev after this pass
+static int thr_cap = 0, thr_nprev = 0; // one capacity for all three
+static long long thr_prev_ms = 0;
+
+static int stat_processor(const char *buf, size_t len) {
+  const char *end = buf + len;
+  const char *rp = memrchr(buf, ')', len);
+  if (!rp || rp + 2 >= end)
+    return -1;
+  const char *p = skip_fields(rp + 2, end, 36); // 3 state -> 39 processor
+  return p < end ? (int)scan_ull(&p, end) : -1;
+}
+
+static int cmp_thrprev(const void *a, const void *b) {
+  pid_t x = ((const ThrPrev *)a)->tid, y = ((const ThrPrev *)b)->tid;
+  return (x > y) - (x < y);
+}
+
+static int cmp_thread_cpu(const void *a, const void *b) {
+  const ThreadRow *x = a, *y = b;
+  if (x->cpu_pct != y->cpu_pct)
+    return x->cpu_pct < y->cpu_pct ? 1 : -1;
+  return (x->tid > y->tid) - (x->tid < y->tid);
+}
+
+static bool thr_reserve(int n) {
+  if (n <= thr_cap)
+    return true;
+  int ncap = thr_cap ? thr_cap * 2 : 256;
+  ThreadRow *na = realloc(thr_all, (size_t)ncap * sizeof(ThreadRow));
+  if (na)
+    thr_all = na;
+  ThrPrev *np = realloc(thr_prev, (size_t)ncap * sizeof(ThrPrev));
+  if (np)
+    thr_prev = np;
+  ThrPrev *nn = realloc(thr_next, (size_t)ncap * sizeof(ThrPrev));
+  if (nn)
+    thr_next = nn;
+  if (!na || !np || !nn)
+    return false;
+  thr_cap = ncap;
+  return true;
+}
+
+static void thread_sample(void) {
+  pid_t pid = atomic_load(&thr_pid);
+  int dfd = proc_root_fd();
+  if (pid != thr_cur_pid) {
+    thr_nprev = 0;
+    thr_cur_pid = pid;
+  }
+  char path[32];
+  snprintf(path, sizeof(path), "%d/task", (int)pid);
+  int tfd = dfd >= 0 ? openat(dfd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)
+                     : -1;
+  thr_gone = tfd < 0;
+  thr_ncur = thr_total = 0;
+  if (tfd < 0)
+    return;
+
+  long long t = now_ms();
+  double span = thr_nprev ? (t - thr_prev_ms) * ticks_per_sec / 1000.0 : 0;
+  int n = 0;
+  char dbuf[8192] __attribute__((aligned(8)));
+  for (;;) {
+    long got = syscall(SYS_getdents64, tfd, dbuf, sizeof(dbuf));
+    if (got <= 0)
+      break;
+    for (long off = 0; off < got;) {
+      struct linux_dirent64 *d = (struct linux_dirent64 *)(dbuf + off);
+      off += d->d_reclen;
+      if ((unsigned)(d->d_name[0] - '1') >= 9 || !thr_reserve(n + 1))
+        continue;
+      char sp[32], buf[1024];
+      snprintf(sp, sizeof(sp), "%s/stat", d->d_name);
+      int fd = openat(tfd, sp, O_RDONLY | O_CLOEXEC);
+      if (fd < 0)
+        continue;
+      ssize_t len = read_retry(fd, buf, sizeof(buf) - 1, -1);
+      close(fd);
+      StatSample ss;
+      if (len <= 0 || parse_stat(buf, (size_t)len, &ss) < 0)
+        continue;
+      buf[len] = '\0';
+      ThreadRow *r = &thr_all[n];
+      r->tid = (pid_t)atoi(d->d_name);
+      snprintf(r->name, sizeof(r->name), "%.15s", ss.comm);
+      r->state = ss.state;
+      r->nicev = ss.nicev;
+      r->cpu_last = stat_processor(buf, (size_t)len);
+      r->ticks = (unsigned long long)ss.ut + ss.st;
+      r->cpu_pct = 0;
+      ThrPrev key = {.tid = r->tid};
+      const ThrPrev *pv =
+          thr_nprev ? bsearch(&key, thr_prev, (size_t)thr_nprev,
+                              sizeof(ThrPrev), cmp_thrprev)
+                    : NULL;
+      // A reused TID shows up with a different start time.
+      if (pv && pv->start == ss.starttime && span > 0 && r->ticks >= pv->ticks)
+        r->cpu_pct = (double)(r->ticks - pv->ticks) * 100.0 / span;
+      thr_next[n] = (ThrPrev){r->tid, r->ticks, ss.starttime};
+      n++;
+    }
+  }
+  close(tfd);
+
+  qsort(thr_next, (size_t)n, sizeof(ThrPrev), cmp_thrprev);
+  ThrPrev *tp = thr_prev;
+  thr_prev = thr_next;
+  thr_next = tp;
+  thr_nprev = n;
+  thr_prev_ms = t;
+
+  qsort(thr_all, (size_t)n, sizeof(ThreadRow), cmp_thread_cpu);
+  thr_total = n;
+  thr_ncur = n < THR_MAX ? n : THR_MAX;
+  memcpy(thr_cur, thr_all, (size_t)thr_ncur * sizeof(ThreadRow));
+}
+
+// ---------- Cgroup Backend ----------
+// With -c the manager throttles instead of stopping. It owns a cgroup v2
+// subtree with two leaves: priority processes move to CG_DIR/priority (high
+// cpu.weight), contending ones to CG_DIR/background (low cpu.weight, a
+// cpu.max cap and memory.high; cgroup.freeze when freezing is switched on).
+// A cycle writes its moves through one open cgroup.procs per leaf, and the
+// limits act on the whole group at once. Each moved PID remembers the
+// cgroup it came from, and resume_suspended() puts it back there.
+//
+// CG_DIR sits directly below CG_ROOT, so the root is the only parent whose
+// subtree_control needs the controllers; cg_init() adds only those missing
+// there, and cg_teardown() takes back what it added and removes CG_DIR. A
+// quitting signal ends the UI loop the same way 'q' does, so the sampler
+// still runs resume_suspended() on its way out.
+#define CG_ROOT "/sys/fs/cgroup"
+#define CG_DIR CG_ROOT "/neotop"
+#define CG_PRIO_WEIGHT "1000"
+#define CG_BG_WEIGHT "10"
+#define CG_BG_CPU_PCT 25  // background cap as % of all CPUs
+#define CG_BG_MEM_PCT 50  // background memory.high as % of MemTotal
+#define CG_MAX_ORIGINS 256
+
+enum { CG_NONE = 0, CG_PRIO, CG_BG };
+
+static bool use_cgroup = false;
+static bool cg_active = false;
+static bool cg_freeze = false;  // under mgr_lock
+static bool cg_frozen = false;  // what background/cgroup.freeze holds
+static int cg_procs_fd[3] = {-1, -1, -1};
+static char *cg_origins[CG_MAX_ORIGINS];
+static int cg_norigins = 0;
+static const char *const cg_ctrl[] = {"cpu", "memory"};
+static unsigned cg_root_added = 0; // cg_ctrl bits cg_init() enabled
+
+static bool cg_write(const char *path, const char *val) {
+  int fd = open(path, O_WRONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  size_t n = strlen(val);
+  bool ok = write(fd, val, n) == (ssize_t)n;
+  close(fd);
+  return ok;
+}
+
+static bool cg_leaf(const char *name, const char *weight) {
+  char path[128];
+  snprintf(path, sizeof(path), CG_DIR "/%s", name);
+  if (mkdir(path, 0755) != 0 && errno != EEXIST)
+    return false;
+  snprintf(path, sizeof(path), CG_DIR "/%s/cpu.weight", name);
+  return cg_write(path, weight);
+}
+
+static int cg_open_procs(const char *name) {
+  char path[128];
+  snprintf(path, sizeof(path), CG_DIR "/%s/cgroup.procs", name);
+  return open(path, O_WRONLY | O_CLOEXEC);
+}
+
+static void cg_init(void) {
+  if (access(CG_ROOT "/cgroup.controllers", R_OK) != 0) {
+    fprintf(stderr, "neotop: -c needs the cgroup v2 hierarchy at %s\n",
+            CG_ROOT);
+    return;
+  }
+  if (mkdir(CG_DIR, 0755) != 0 && errno != EEXIST) {
+    fprintf(stderr, "neotop: cannot create %s: %s\n", CG_DIR, strerror(errno));
+    return;
+  }
+  // The root usually has both controllers enabled already; the subtree
+  // needs them for its leaves. Failures show up when setting the limits.
+  char on[256];
+  int fd = open(CG_ROOT "/cgroup.subtree_control", O_RDONLY | O_CLOEXEC);
+  ssize_t n = fd < 0 ? -1 : read_retry(fd, on, sizeof(on) - 1, -1);
+  if (fd >= 0)
+    close(fd);
+  on[n > 0 ? n : 0] = '\0';
+  unsigned have = 0;
+  char *save;
+  for (char *t = strtok_r(on, " \n", &save); t;
+       t = strtok_r(NULL, " \n", &save))
+    for (int i = 0; i < 2; i++)
+      if (!strcmp(t, cg_ctrl[i]))
+        have |= 1u << i;
+  for (int i = 0; i < 2; i++) {
+    char v[16];
+    snprintf(v, sizeof(v), "+%s", cg_ctrl[i]);
+    if (!(have & 1u << i) && cg_write(CG_ROOT "/cgroup.subtree_control", v))
+      cg_root_added |= 1u << i;
+  }
+  cg_write(CG_DIR "/cgroup.subtree_control", "+cpu +memory");
+
+  char buf[64];
+  long quota = 100000L * NCPU * CG_BG_CPU_PCT / 100;
+  snprintf(buf, sizeof(buf), "%ld 100000", quota);
+  if (!cg_leaf("priority", CG_PRIO_WEIGHT) ||
+      !cg_leaf("background", CG_BG_WEIGHT) ||
+      !cg_write(CG_DIR "/background/cpu.max", buf)) {
+    fprintf(stderr, "neotop: cannot configure %s, using signals\n", CG_DIR);
+    return;
+  }
+  MemSnap m;
+  if (mem_read_kb(&m) == 0 && m.total_kb) {
+    snprintf(buf, sizeof(buf), "%lu",
+             m.total_kb / 100 * CG_BG_MEM_PCT * 1024);
+    cg_write(CG_DIR "/background/memory.high", buf);
+  }
+  cg_procs_fd[CG_PRIO] = cg_open_procs("priority");
+  cg_procs_fd[CG_BG] = cg_open_procs("background");
+  cg_active = cg_procs_fd[CG_PRIO] >= 0 && cg_procs_fd[CG_BG] >= 0;
+  if (!cg_active)
+    fprintf(stderr, "neotop: cannot open %s leaves, using signals\n", CG_DIR);
+}
+
+// Interns the cgroup a PID lives in now; 1-based, 0 when unknown.
+static int cg_origin_of(pid_t pid) {
+  char path[64], buf[512];
+  snprintf(path, sizeof(path), "%d/cgroup", (int)pid);
+  int fd = openat(proc_root_fd(), path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return 0;
+  ssize_t n = read_retry(fd, buf, sizeof(buf) - 1, -1);
+  close(fd);
+  if (n < 4 || memcmp(buf, "0::", 3) != 0)
+    return 0;
+  buf[n] = '\0';
+  buf[strcspn(buf, "\n")] = '\0';
+  const char *cg = buf + 3;
+  if (!strncmp(cg, "/neotop/", 8))
+    return 0; // left behind by an earlier run; nowhere known to return to
+  for (int i = 0; i < cg_norigins; i++)
+    if (!strcmp(cg_origins[i], cg))
+      return i + 1;
+  if (cg_norigins == CG_MAX_ORIGINS)
+    return 0;
+  char *dup = strdup(cg);
+  if (!dup)
+    return 0;
+  cg_origins[cg_norigins++] = dup;
+  return cg_norigins;
+}
+
+static bool cg_write_pid(int fd, pid_t pid) {
+  char num[16];
+  int n = snprintf(num, sizeof(num), "%d", (int)pid);
+  return write(fd, num, (size_t)n) == n;
+}
+
+static bool cg_move(PEntry *pe, int group) {
+  if (pe->cg_group == group)
+    return true;
+  if (!pe->cg_origin) {
+    pe->cg_origin = (uint16_t)cg_origin_of(pe->pid);
+    if (!pe->cg_origin)
+      return false;
+  }
+  if (!cg_write_pid(cg_procs_fd[group], pe->pid))
+    return false;
+  pe->cg_group = (unsigned char)group;
+  pe->grp = 0; // the grouped view re-reads where it lives now
+  return true;
+}
+
+static void cg_set_frozen(bool on) {
+  if (on != cg_frozen &&
+      cg_write(CG_DIR "/background/cgroup.freeze", on ? "1" : "0"))
+    cg_frozen = on;
+}
+
+// Puts every moved PID back into the cgroup it came from. The origin
+// cgroup.procs files are opened once each for the batch.
+static void cg_restore_all(void) {
+  int fds[CG_MAX_ORIGINS];
+  for (int i = 0; i < cg_norigins; i++)
+    fds[i] = -2;
+  cg_set_frozen(false);
+  for (size_t i = 0; i < ptab_cap; i++) {
+    PEntry *pe = &ptab[i];
+    if (pe->pid == 0 || pe->cg_group == CG_NONE)
+      continue;
+    int o = pe->cg_origin - 1;
+    if (fds[o] == -2) {
+      char path[600];
+      snprintf(path, sizeof(path), CG_ROOT "%s/cgroup.procs", cg_origins[o]);
+      fds[o] = open(path, O_WRONLY | O_CLOEXEC);
+    }
+    if (fds[o] >= 0)
+      cg_write_pid(fds[o], pe->pid);
+    pe->cg_group = CG_NONE;
+    pe->grp = 0;
+  }
+  for (int i = 0; i < cg_norigins; i++)
+    if (fds[i] >= 0)
+      close(fds[i]);
+}
+
+static void cg_restore(PEntry *pe) {
+  if (pe->cg_group == CG_NONE)
+    return;
+  char path[600], num[16];
+  snprintf(path, sizeof(path), CG_ROOT "%s/cgroup.procs",
+           cg_origins[pe->cg_origin - 1]);
+  snprintf(num, sizeof(num), "%d", (int)pe->pid);
+  cg_write(path, num);
+  pe->cg_group = CG_NONE;
+  pe->grp = 0;
+}
+
+// Undoes cg_init() once the sampler is gone: registered with atexit(), so
+// it also runs when main() bails out early.
+static void cg_teardown(void) {
+  if (cg_active)
+    cg_restore_all();
+  for (int g = CG_PRIO; g <= CG_BG; g++)
+    if (cg_procs_fd[g] >= 0)
+      close(cg_procs_fd[g]);
+  cg_active = false;
+  rmdir(CG_DIR "/priority");
+  rmdir(CG_DIR "/background");
+  rmdir(CG_DIR);
+  for (int i = 0; i < 2; i++) {
+    char v[16];
+    snprintf(v, sizeof(v), "-%s", cg_ctrl[i]);
+    if (cg_root_added & 1u << i)
+      cg_write(CG_ROOT "/cgroup.subtree_control", v);
   }
-  fclose(f);
-  unsigned long long u, n, s, idle, iow, irq, sirq, steal;
-  char lab[8];
-  sscanf(buf, "%7s %llu %llu %llu %llu %llu %llu %llu %llu", lab, &u, &n, &s,
-         &idle, &iow, &irq, &sirq, &steal);
-  long long tot = (long long)(u + n + s + idle + iow + irq + sirq + steal);
-  gtot_prev = gtot_cur;
-  gtot_cur = tot;
 }
 
-static void scan_processes(void) {
-  static PInfo prev[MAX_PROCS];
-  static int prevn = 0;
-  static long long prev_time_ms = 0;
+// ---------- Policy Engine ----------
+// Once a priority process is busy, the manager escalates a contending process
+// one step at a time: renice, then the background cgroup (with -c), then
+// SIGSTOP. CPU is judged on an EWMA of cpu_pct, so one busy scan does not
+// count. A step up needs pol_cfg.enter scans in a row over the enter
+// thresholds. A reniced or throttled process steps back down after
+// pol_cfg.exit scans below the lower exit thresholds; the gap between the two
+// is the hysteresis. A stopped process shows no CPU of its own, so it is held
+// until the priority workload has been idle (summed smoothed CPU under
+// idle_cpu) for pol_cfg.idle scans. After that every managed process is
+// released. A cycle applies at most pol_cfg.rate changes: releases first,
+// then the busiest escalations, and whatever is left waits for the next cycle.
+// Each change goes to the decision log on the manager page.
+#define POL_ALPHA 0.4 // EWMA weight of the newest scan
+#define POL_NICE 15   // renice target; lower nices are left alone
+#define POL_LOG 64
+
+enum { POL_NONE, POL_RENICE, POL_THROTTLE, POL_STOP, NPOL };
+static const char *pol_name[NPOL] = {"none", "renice", "throttle", "stop"};
+
+enum { WHY_CPU, WHY_RSS, WHY_CALM, WHY_IDLE, WHY_PROTECTED, WHY_RESUME };
+static const char *why_name[] = {"cpu", "rss", "calm", "prio idle",
+                                 "protected", "resume"};
 
-  long long curr_time_ms = now_ms();
-  long long time_diff_ms =
-      (prev_time_ms > 0) ? (curr_time_ms - prev_time_ms) : 1500;
+typedef struct {
+  double cpu_enter, cpu_exit, idle_cpu; // % of one CPU
+  unsigned long rss_enter_kb, rss_exit_kb;
+  int enter, exit, idle; // scans
+  int rate;              // changes per cycle
+} PolicyCfg;
+
+static PolicyCfg pol_cfg = {10.0, 5.0, 1.0, 500 * 1024, 400 * 1024,
+                            3,    5,   3,   4};
+
+// Under mgr_lock; pol_nlog counts every decision ever logged.
+typedef struct {
+  time_t t;
+  pid_t pid;
+  char comm[24];
+  unsigned char from, to, why;
+  float cpu;
+  unsigned long rss_kb;
+} PolEvent;
+
+static PolEvent pol_log[POL_LOG];
+static unsigned pol_nlog = 0;
+static double pol_prio_avg = 0; // smoothed CPU of the priority workload
+static int pol_idle = 0;        // scans it has been idle in a row
+
+// "-m cpu=10,cpu-exit=5,rss=500,rss-exit=400,enter=3,exit=5,idle=3,
+// idle-cpu=1,rate=4"; RSS in MB, every key optional.
+static bool pol_parse(const char *spec) {
+  PolicyCfg c = pol_cfg;
+  for (const char *p = spec; *p;) {
+    const char *eq = strchr(p, '=');
+    if (!eq)
+      return false;
+    char *e;
+    double v = strtod(eq + 1, &e);
+    if (e == eq + 1 || v < 0 || (*e && *e != ','))
+      return false;
+    size_t k = (size_t)(eq - p);
+#define KEY(s) (k == sizeof(s) - 1 && !strncmp(p, s, k))
+    if (KEY("cpu"))
+      c.cpu_enter = v;
+    else if (KEY("cpu-exit"))
+      c.cpu_exit = v;
+    else if (KEY("rss"))
+      c.rss_enter_kb = (unsigned long)(v * 1024);
+    else if (KEY("rss-exit"))
+      c.rss_exit_kb = (unsigned long)(v * 1024);
+    else if (KEY("enter"))
+      c.enter = (int)v;
+    else if (KEY("exit"))
+      c.exit = (int)v;
+    else if (KEY("idle"))
+      c.idle = (int)v;
+    else if (KEY("idle-cpu"))
+      c.idle_cpu = v;
+    else if (KEY("rate"))
+      c.rate = (int)v;
+    else
+      return false;
+#undef KEY
+    p = *e ? e + 1 : e;
+  }
+  if (c.cpu_exit > c.cpu_enter || c.rss_exit_kb > c.rss_enter_kb ||
+      c.enter < 1 || c.exit < 1 || c.idle < 1 || c.rate < 1)
+    return false;
+  pol_cfg = c;
+  return true;
+}
+
+static void pol_note(pid_t pid, const char *comm, int from, int to, int why,
+                     double cpu_avg, unsigned long rss_kb) {
+  PolEvent *ev = &pol_log[pol_nlog++ % POL_LOG];
+  *ev = (PolEvent){.t = time(NULL),
+                   .pid = pid,
+                   .from = (unsigned char)from,
+                   .to = (unsigned char)to,
+                   .why = (unsigned char)why,
+                   .cpu = (float)cpu_avg,
+                   .rss_kb = rss_kb};
+  snprintf(ev->comm, sizeof(ev->comm), "%s", comm);
+}
+
+// The throttle step only exists with the cgroup backend.
+static int pol_up(int l) {
+  return l + 1 == POL_THROTTLE && !cg_active ? POL_STOP : l + 1;
+}
+
+static int pol_down(int l) {
+  return l - 1 == POL_THROTTLE && !cg_active ? POL_RENICE : l - 1;
+}
+
+// On Linux a nice value belongs to a thread, so the renice step walks
+// /proc/<pid>/task. Raising moves every thread below POL_NICE up to it.
+// Restoring moves every thread still at POL_NICE back to `nice`, the main
+// thread's value before the step; a thread that reniced itself meanwhile
+// keeps its own choice. Threads that exit during the walk are skipped.
+// Returns false if any thread could not be changed; going back below the
+// current nice needs CAP_SYS_NICE.
+static bool pol_renice(pid_t pid, bool raise, int nice) {
+  char path[32];
+  snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+  int tfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (tfd < 0)
+    return !raise && errno == ENOENT; // nothing left to restore
+  bool ok = true;
+  char dbuf[4096] __attribute__((aligned(8)));
+  long got;
+  while ((got = syscall(SYS_getdents64, tfd, dbuf, sizeof(dbuf))) > 0) {
+    for (long off = 0; off < got;) {
+      struct linux_dirent64 *d = (struct linux_dirent64 *)(dbuf + off);
+      off += d->d_reclen;
+      if ((unsigned)(d->d_name[0] - '1') >= 9)
+        continue;
+      id_t tid = (id_t)atoi(d->d_name);
+      errno = 0;
+      int cur = getpriority(PRIO_PROCESS, tid);
+      if (errno) {
+        ok &= errno == ESRCH;
+        continue;
+      }
+      if (raise ? cur >= POL_NICE : cur != POL_NICE)
+        continue;
+      if (setpriority(PRIO_PROCESS, tid, raise ? POL_NICE : nice) != 0)
+        ok &= errno == ESRCH;
+    }
+  }
+  close(tfd);
+  return ok;
+}
+
+// Moves pe one or more steps to `to`, undoing or applying each step in turn.
+// A step that fails leaves the process where it got to, in either
+// direction, so the log never records a change that did not happen.
+static void pol_set(PEntry *pe, int to) {
+  while (pe->pol < to) {
+    int next = pol_up(pe->pol);
+    bool ok = true;
+    if (next == POL_RENICE) {
+      errno = 0;
+      int old = getpriority(PRIO_PROCESS, pe->pid);
+      if (errno)
+        return;
+      pe->pol_nice = (signed char)old;
+      // Threads moved before a failure are only put back by a release, so
+      // the level is recorded either way.
+      if (!pol_renice(pe->pid, true, 0)) {
+        pe->pol = POL_RENICE;
+        return;
+      }
+    } else if (next == POL_THROTTLE) {
+      ok = cg_move(pe, CG_BG);
+    } else {
+      ok = kill(pe->pid, SIGSTOP) == 0;
+    }
+    if (!ok)
+      return;
+    pe->pol = (unsigned char)next;
+  }
+  while (pe->pol > to) {
+    if (pe->pol == POL_STOP)
+      kill(pe->pid, SIGCONT);
+    else if (pe->pol == POL_THROTTLE)
+      cg_restore(pe);
+    else if (!pol_renice(pe->pid, false, pe->pol_nice))
+      return;
+    pe->pol = (unsigned char)pol_down(pe->pol);
+  }
+}
+
+typedef struct {
+  PInfo *p;
+  PEntry *pe;
+  int to, why;
+} PolCand;
+
+static int cmp_cand(const void *a, const void *b) {
+  const PolCand *x = a, *y = b;
+  bool xd = x->to < x->pe->pol, yd = y->to < y->pe->pol;
+  if (xd != yd)
+    return xd ? -1 : 1;
+  return (y->pe->cpu_avg > x->pe->cpu_avg) - (y->pe->cpu_avg < x->pe->cpu_avg);
+}
+
+static void manage_resources(void) {
+  static PolCand *cand = NULL;
+  static int cand_cap = 0;
+  pthread_mutex_lock(&mgr_lock);
+  mgr_engaged = false;
+  if (!auto_manage_enabled || !matcher.nstates)
+    goto out;
+  if (cand_cap < nprocs) {
+    PolCand *nc = realloc(cand, (size_t)nprocs * sizeof(PolCand));
+    if (!nc)
+      goto out;
+    cand = nc;
+    cand_cap = nprocs;
+  }
+
+  double prio = 0;
+  bool prio_running = false;
+  for (int i = 0; i < nprocs; i++) {
+    if ((procs[i].cls & CLS_PRIO) && procs[i].running) {
+      prio_running = true;
+      prio += procs[i].cpu_pct;
+    }
+  }
+  pol_prio_avg = POL_ALPHA * prio + (1 - POL_ALPHA) * pol_prio_avg;
+  if (prio_running && pol_prio_avg >= pol_cfg.idle_cpu)
+    pol_idle = 0;
+  else if (pol_idle < pol_cfg.idle)
+    pol_idle++;
+  // Short lulls in the priority workload do not release anything.
+  bool engaged = prio_running && pol_idle < pol_cfg.idle;
+  if (cg_active)
+    cg_set_frozen(engaged && cg_freeze);
+
+  int ncand = 0;
+  for (int i = 0; i < nprocs; i++) {
+    PInfo *p = &procs[i];
+    PEntry *pe = ptab_find(p->pid);
+    if (!pe)
+      continue;
+    if (p->cls & CLS_PRIO) {
+      if (engaged && cg_active && p->running)
+        cg_move(pe, CG_PRIO);
+    }
+    pe->cpu_avg = (float)(POL_ALPHA * p->cpu_pct +
+                          (1 - POL_ALPHA) * pe->cpu_avg);
+    int to = pe->pol, why = WHY_CALM;
+    if (!engaged) {
+      to = POL_NONE;
+      why = WHY_IDLE;
+    } else if ((p->cls & (CLS_PRIO | CLS_CRIT)) || p->uid == 0) {
+      to = POL_NONE; // matched since it was throttled
+      why = WHY_PROTECTED;
+    } else if (pe->pol != POL_STOP) {
+      bool cpu_hot = pe->cpu_avg > pol_cfg.cpu_enter;
+      bool hot = cpu_hot || p->rss_kb > pol_cfg.rss_enter_kb;
+      bool calm = pe->cpu_avg < pol_cfg.cpu_exit &&
+                  p->rss_kb < pol_cfg.rss_exit_kb;
+      pe->over = hot ? (pe->over < 255 ? pe->over + 1 : 255) : 0;
+      pe->under = calm ? (pe->under < 255 ? pe->under + 1 : 255) : 0;
+      if (p->running && pe->over >= pol_cfg.enter) {
+        to = pol_up(pe->pol);
+        why = cpu_hot ? WHY_CPU : WHY_RSS;
+      } else if (pe->pol && pe->under >= pol_cfg.exit) {
+        to = pol_down(pe->pol);
+      }
+    }
+    if (to != pe->pol)
+      cand[ncand++] = (PolCand){p, pe, to, why};
+  }
+
+  qsort(cand, (size_t)ncand, sizeof(PolCand), cmp_cand);
+  for (int i = 0; i < ncand && i < pol_cfg.rate; i++) {
+    PolCand *c = &cand[i];
+    int from = c->pe->pol;
+    pol_set(c->pe, c->to);
+    if (c->pe->pol == from)
+      continue;
+    c->pe->over = c->pe->under = 0;
+    pol_note(c->p->pid, c->p->comm, from, c->pe->pol, c->why,
+             c->pe->cpu_avg, c->p->rss_kb);
+    set_suspended(c->p, c->pe->pol != POL_NONE);
+    if (c->pe->pol == POL_STOP || from == POL_STOP)
+      c->p->running = c->pe->pol != POL_STOP;
+  }
+  mgr_engaged = engaged || n_suspended > 0;
+out:
+  pthread_mutex_unlock(&mgr_lock);
+}
+
+// Works on the PID table rather than `procs`: the current table may already
+// be published and must not change under the UI.
+static void resume_suspended(void) {
+  if (cg_active)
+    cg_restore_all();
+  int n = 0, top = POL_NONE;
+  for (size_t i = 0; i < ptab_cap; i++) {
+    PEntry *pe = &ptab[i];
+    if (pe->pid != 0 && pe->suspended_by_manager) {
+      int from = pe->pol;
+      pol_set(pe, POL_NONE); // the cgroup step was undone above
+      if (pe->pol != POL_NONE)
+        continue; // the renice could not be undone; still managed
+      if (from > top)
+        top = from;
+      pe->suspended_by_manager = false;
+      pe->over = pe->under = 0;
+      n_suspended--;
+      n++;
+    }
+  }
+  if (!n)
+    return;
+  char what[24];
+  snprintf(what, sizeof(what), "%d managed", n);
+  pthread_mutex_lock(&mgr_lock);
+  pol_note(0, what, top, POL_NONE, WHY_RESUME, 0, 0);
+  pthread_mutex_unlock(&mgr_lock);
+}
+
+static int cmp_cpu(const void *a, const void *b) {
+  const PInfo *x = a, *y = b;
+  if (y->cpu_pct > x->cpu_pct)
+    return 1;
+  if (y->cpu_pct < x->cpu_pct)
+    return -1;
+  return (int)(x->pid - y->pid);
+}
+
+static int cmp_mem(const void *a, const void *b) {
+  const PInfo *x = a, *y = b;
+  if (y->rss_kb > x->rss_kb)
+    return 1;
+  if (y->rss_kb < x->rss_kb)
+    return -1;
+  return (int)(x->pid - y->pid);
+}
+
+static int cmp_pid(const void *a, const void *b) {
+  const PInfo *x = a, *y = b;
+  return (x->pid > y->pid) - (x->pid < y->pid);
+}
+
+static int cmp_name(const void *a, const void *b) {
+  const PInfo *x = a, *y = b;
+  int r = strcasecmp(x->comm, y->comm);
+  return r ? r : cmp_pid(a, b);
+}
+
+static int cmp_user(const void *a, const void *b) {
+  const PInfo *x = a, *y = b;
+  int r = strcmp(x->user ? x->user : "", y->user ? y->user : "");
+  return r ? r : cmp_cpu(a, b);
+}
+
+// Rows without a sample of the counter sort after every row that has one.
+static int cmp_rate(double x, double y, bool hx, bool hy) {
+  if (hx != hy)
+    return hx ? -1 : 1;
+  return (y > x) - (y < x);
+}
+
+static int cmp_io(const void *a, const void *b) {
+  const PInfo *x = a, *y = b;
+  int r = cmp_rate(x->rd_bps + x->wr_bps, y->rd_bps + y->wr_bps,
+                   x->ext & EXT_IO, y->ext & EXT_IO);
+  return r ? r : cmp_pid(a, b);
+}
+
+static int cmp_csw(const void *a, const void *b) {
+  const PInfo *x = a, *y = b;
+  int r = cmp_rate(x->csw_ps, y->csw_ps, x->ext & EXT_CSW, y->ext & EXT_CSW);
+  return r ? r : cmp_pid(a, b);
+}
+
+static int cmp_thr(const void *a, const void *b) {
+  const PInfo *x = a, *y = b;
+  int r = (y->threads > x->threads) - (y->threads < x->threads);
+  return r ? r : cmp_pid(a, b);
+}
+
+// ---------- Sampler Thread ----------
+// All collection runs here so a slow /proc walk never delays input handling
+// or drawing. The sampler sleeps in poll() on two timerfds, one per sampling
+// interval, and an eventfd the UI writes through sampler_kick(); the UI in
+// turn sleeps on stdin and ui_evfd, which snap_publish() signals. Nothing
+// wakes up on a fixed frame clock.
+static pthread_t sampler_tid;
+static int samp_evfd = -1, cpu_tfd = -1, proc_tfd = -1, sens_tfd = -1;
+static int thr_tfd = -1;
+static atomic_int ui_page;
+static atomic_bool samp_stop, scan_req, resume_req;
+
+static void sampler_kick(void) { evfd_signal(samp_evfd); }
+
+static void timer_arm(int tfd, long ms) {
+  struct itimerspec it = {0};
+  it.it_interval.tv_sec = ms / 1000;
+  it.it_interval.tv_nsec = (ms % 1000) * 1000000L;
+  it.it_value = it.it_interval;
+  timerfd_settime(tfd, 0, &it, NULL);
+}
+
+// Re-arming restarts the period, so it only happens when the value moved.
+static bool cad_arm(int tfd, long *cur, long ms) {
+  if (*cur == ms)
+    return false;
+  *cur = ms;
+  timer_arm(tfd, ms);
+  return true;
+}
+
+static bool sampler_init(void) {
+  int fl = EFD_NONBLOCK | EFD_CLOEXEC;
+  samp_evfd = eventfd(0, fl);
+  ui_evfd = eventfd(0, fl);
+  cpu_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  proc_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  sens_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  thr_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  return samp_evfd >= 0 && ui_evfd >= 0 && cpu_tfd >= 0 && proc_tfd >= 0 &&
+         sens_tfd >= 0 && thr_tfd >= 0;
+}
+
+static bool page_wants_procs(int pg);
+static bool page_wants_cpu(int pg);
+static bool page_wants_sensors(int pg);
+static bool page_wants_core_hist(int pg);
+static bool page_wants_ext(int pg);
+static bool page_wants_threads(int pg);
+static bool page_wants_sysinfo(int pg);
+
+static void *sampler_main(void *arg) {
+  (void)arg;
+  pool_start();
+  cpu_sample();
+  push_mem_hist();
+  usleep(100000);
+  cpu_sample();
+  push_mem_hist();
+  scan_processes();
+  snap_publish();
+
+  // The CPU timer always runs so the CPU and memory history has no gaps
+  // whatever page is open; a page showing CPU samples as soon as it opens.
+  // The other timers only run while the current page shows what they
+  // sample. A timer that comes back on samples once right away instead of
+  // waiting out its first interval.
+  bool proc_on = false, sens_on = false;
+  int shown = -1;
+  while (!atomic_load(&samp_stop)) {
+    int pg = atomic_load(&ui_page);
+    bool cpu_due = false, proc_due = false, sens_due = false, thr_due = false;
+    if (pg != shown) {
+      shown = pg;
+      cpu_due = page_wants_cpu(pg);
+    }
+    if (page_wants_procs(pg) != proc_on) {
+      proc_on = !proc_on;
+      proc_due = proc_on;
+    }
+    // A new interval is published so the UI shows the one in use.
+    bool moved = cad_arm(cpu_tfd, &cad_cpu_cur, cad_cpu_ms());
+    moved |= cad_arm(proc_tfd, &cad_proc_cur, proc_on ? cad_proc_ms() : 0);
+    if (page_wants_sensors(pg) != sens_on) {
+      sens_on = !sens_on;
+      timer_arm(sens_tfd, sens_on ? SENSOR_MS : 0);
+      sens_due = sens_on;
+      sysi_next = 0;
+    }
+    if (page_wants_threads(pg) != thr_live) {
+      thr_live = !thr_live;
+      timer_arm(thr_tfd, thr_live ? THREAD_MS : 0);
+      thr_due = thr_live;
+    }
+
+    if (!cpu_due && !proc_due && !sens_due && !thr_due && !moved) {
+      struct pollfd pfd[5] = {{.fd = samp_evfd, .events = POLLIN},
+                              {.fd = cpu_tfd, .events = POLLIN},
+                              {.fd = proc_tfd, .events = POLLIN},
+                              {.fd = sens_tfd, .events = POLLIN},
+                              {.fd = thr_tfd, .events = POLLIN}};
+      poll(pfd, 5, -1);
+      evfd_drain(samp_evfd);
+      cpu_due = evfd_drain(cpu_tfd);
+      proc_due = evfd_drain(proc_tfd);
+      sens_due = evfd_drain(sens_tfd);
+      thr_due = evfd_drain(thr_tfd);
+    }
+    bool published = moved;
+
+    // The UI may switch to another process without leaving the page.
+    if (thr_live && atomic_load(&thr_pid) != thr_cur_pid)
+      thr_due = true;
+    if (thr_due) {
+      thread_sample();
+      published = true;
+    }
+
+    if (sens_due) {
+      sensors_sample();
+      psi_sample();
+      if (page_wants_sysinfo(pg))
+        sysi_sample();
+      published = true;
+    }
+
+    if (atomic_exchange(&resume_req, false)) {
+      resume_suspended();
+      published = true;
+    }
+
+    bool want_scan = atomic_exchange(&scan_req, false);
+    // A process scan always rides on a fresh /proc/stat sample so both use
+    // the same jiffy counter.
+    if (cpu_due || proc_due || want_scan) {
+      cpu_sample();
+      push_mem_hist();
+      hist_record();
+      if (page_wants_core_hist(pg))
+        hist_reduce(&core_hist);
+      published = true;
+    }
+    if (proc_due || want_scan) {
+      scan_processes();
+      cad_note_scan();
+      if (page_wants_ext(pg))
+        ext_sample();
+      manage_resources();
+    }
+    // A forced scan restarts both intervals from now.
+    if (want_scan) {
+      timer_arm(cpu_tfd, cad_cpu_cur);
+      if (proc_on)
+        timer_arm(proc_tfd, cad_proc_cur);
+    }
+    if (published)
+      snap_publish();
+  }
+  // Whatever the backend, nothing the manager stopped, reniced or throttled
+  // outlives us.
+  resume_suspended();
+  pool_stop();
+  return NULL;
+}
+
+// ---------- Headless Output ----------
+// With -o the collectors run on the main thread without ncurses and one
+// record per interval goes to stdout (or -O file). A record carries the
+// system metrics in full but only the per-process delta against the
+// previous record: PIDs that appeared, PIDs whose visible fields changed
+// (only those fields are sent), and PIDs that exited. The first record
+// lists every process as new.
+//
+// With -P each record also carries neotop's own cost ("prof" in json).
+//
+// json: one object per line.
+// bin:  u32 payload length, then the payload, all little-endian:
+//   u8 version (1, or 2 when a profile block follows) u64 t_ms u32 seq
+//   u16 ncores f32 total f32 core[ncores] f32 freq_mhz[ncores] f32 temp_c
+//   u64 mem[7] (total free avail buffers cached swap_total swap_free, kB)
+//   u32 nprocs
+//   u32 nnew  { i32 pid u32 uid u8 len comm[len] f32 cpu u64 rss_kb
+//               i8 nice u8 running }
+//   u32 nchg  { i32 pid u8 mask [comm][cpu][rss][nice][running] }
+//   u32 nexit { i32 pid }
+//   version 2: u8 nstages { u32 p50_ns u32 p99_ns } f32 cpu_pct u64 rss_kb
+//              u64 syscalls u64 read_bytes u32 interval_ms
+enum { OUT_NONE = 0, OUT_JSON, OUT_BIN };
+enum { D_COMM = 1, D_CPU = 2, D_RSS = 4, D_NICE = 8, D_RUN = 16 };
+
+static int out_fmt = OUT_NONE;
+static const char *out_path = NULL;
+static long out_ms = PROC_MS;
+static volatile sig_atomic_t hl_stop = 0;
+
+typedef struct {
+  char *p;
+  size_t n, cap;
+  bool bad; // an append failed, so the contents are incomplete
+} OutBuf;
+
+static void ob_put(OutBuf *b, const void *src, size_t n) {
+  if (b->bad)
+    return;
+  if (b->n + n > b->cap) {
+    size_t ncap = b->cap ? b->cap : 4096;
+    while (ncap < b->n + n)
+      ncap *= 2;
+    char *np = realloc(b->p, ncap);
+    if (!np) {
+      b->bad = true;
+      return;
+    }
+    b->p = np;
+    b->cap = ncap;
+  }
+  memcpy(b->p + b->n, src, n);
+  b->n += n;
+}
+
+static void ob_printf(OutBuf *b, const char *fmt, ...) {
+  char tmp[256];
+  va_list ap;
+  va_start(ap, fmt);
+  int w = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+  va_end(ap);
+  if (w > 0)
+    ob_put(b, tmp, (size_t)w < sizeof(tmp) ? (size_t)w : sizeof(tmp) - 1);
+}
+
+static void ob_le(OutBuf *b, uint64_t v, int bytes) {
+  unsigned char t[8];
+  for (int i = 0; i < bytes; i++)
+    t[i] = (unsigned char)(v >> (8 * i));
+  ob_put(b, t, (size_t)bytes);
+}
+
+static void ob_f32(OutBuf *b, double v) {
+  float f = (float)v;
+  uint32_t u;
+  memcpy(&u, &f, sizeof(u));
+  ob_le(b, u, 4);
+}
+
+// Length of the well-formed UTF-8 sequence starting at s, or 0. The ranges
+// rule out overlong forms, surrogates and code points past U+10FFFF; the
+// NUL terminator fails every continuation test, so reads stop there.
+static int utf8_len(const unsigned char *s) {
+  unsigned c = s[0];
+  int n = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : c >= 0xc2 ? 2 : 0;
+  if (!n || c > 0xf4)
+    return 0;
+  unsigned lo = c == 0xe0 ? 0xa0 : c == 0xf0 ? 0x90 : 0x80;
+  unsigned hi = c == 0xed ? 0x9f : c == 0xf4 ? 0x8f : 0xbf;
+  if (s[1] < lo || s[1] > hi)
+    return 0;
+  for (int i = 2; i < n; i++)
+    if ((s[i] & 0xc0) != 0x80)
+      return 0;
+  return n;
+}
+
+// The kernel cuts comm at a byte count, which can split a multi-byte
+// character; bytes that are not part of a valid sequence become U+FFFD so
+// every record stays valid JSON.
+static void ob_jstr(OutBuf *b, const char *s) {
+  ob_put(b, "\"", 1);
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    int n;
+    if (c == '"' || c == '\\') {
+      ob_printf(b, "\\%c", c);
+    } else if (c < 0x20) {
+      ob_printf(b, "\\u%04x", c);
+    } else if (c < 0x80) {
+      ob_put(b, s, 1);
+    } else if ((n = utf8_len((const unsigned char *)s)) > 0) {
+      ob_put(b, s, (size_t)n);
+      s += n - 1;
+    } else {
+      ob_printf(b, "\\ufffd");
+    }
+  }
+  ob_put(b, "\"", 1);
+}
+
+static int cmp_pinfo_pid(const void *a, const void *b) {
+  pid_t x = ((const PInfo *)a)->pid, y = ((const PInfo *)b)->pid;
+  return (x > y) - (x < y);
+}
+
+static unsigned pinfo_delta(const PInfo *o, const PInfo *n) {
+  unsigned m = 0;
+  if (strcmp(o->comm, n->comm) != 0)
+    m |= D_COMM;
+  if (llround(o->cpu_pct * 10) != llround(n->cpu_pct * 10))
+    m |= D_CPU;
+  if (o->rss_kb != n->rss_kb)
+    m |= D_RSS;
+  if (o->nicev != n->nicev)
+    m |= D_NICE;
+  if (o->running != n->running)
+    m |= D_RUN;
+  return m;
+}
+
+static void emit_new_json(OutBuf *b, const PInfo *p, bool *first) {
+  ob_printf(b, "%s{\"pid\":%d,\"uid\":%u,\"user\":", *first ? "" : ",",
+            (int)p->pid, (unsigned)p->uid);
+  ob_jstr(b, p->user ? p->user : "unknown");
+  ob_printf(b, ",\"comm\":");
+  ob_jstr(b, p->comm);
+  ob_printf(b, ",\"cpu\":%.1f,\"rss_kb\":%lu,\"nice\":%d,\"running\":%s}",
+            p->cpu_pct, p->rss_kb, p->nicev, p->running ? "true" : "false");
+  *first = false;
+}
+
+static void emit_chg_json(OutBuf *b, const PInfo *p, unsigned m, bool *first) {
+  ob_printf(b, "%s{\"pid\":%d", *first ? "" : ",", (int)p->pid);
+  if (m & D_COMM) {
+    ob_printf(b, ",\"comm\":");
+    ob_jstr(b, p->comm);
+  }
+  if (m & D_CPU)
+    ob_printf(b, ",\"cpu\":%.1f", p->cpu_pct);
+  if (m & D_RSS)
+    ob_printf(b, ",\"rss_kb\":%lu", p->rss_kb);
+  if (m & D_NICE)
+    ob_printf(b, ",\"nice\":%d", p->nicev);
+  if (m & D_RUN)
+    ob_printf(b, ",\"running\":%s", p->running ? "true" : "false");
+  ob_put(b, "}", 1);
+  *first = false;
+}
+
+static void emit_new_bin(OutBuf *b, const PInfo *p) {
+  size_t len = strnlen(p->comm, MAX_COMM - 1);
+  ob_le(b, (uint32_t)p->pid, 4);
+  ob_le(b, p->uid, 4);
+  ob_le(b, len, 1);
+  ob_put(b, p->comm, len);
+  ob_f32(b, p->cpu_pct);
+  ob_le(b, p->rss_kb, 8);
+  ob_le(b, (uint8_t)(int8_t)p->nicev, 1);
+  ob_le(b, p->running, 1);
+}
+
+static void emit_chg_bin(OutBuf *b, const PInfo *p, unsigned m) {
+  ob_le(b, (uint32_t)p->pid, 4);
+  ob_le(b, m, 1);
+  if (m & D_COMM) {
+    size_t len = strnlen(p->comm, MAX_COMM - 1);
+    ob_le(b, len, 1);
+    ob_put(b, p->comm, len);
+  }
+  if (m & D_CPU)
+    ob_f32(b, p->cpu_pct);
+  if (m & D_RSS)
+    ob_le(b, p->rss_kb, 8);
+  if (m & D_NICE)
+    ob_le(b, (uint8_t)(int8_t)p->nicev, 1);
+  if (m & D_RUN)
+    ob_le(b, p->running, 1);
+}
+
+// Walks the previous and current tables in PID order. Each pass over the
+// pair emits one class of entry; the counts for the binary header are
+// patched in afterwards.
+enum { PASS_NEW, PASS_CHG, PASS_EXIT };
+
+static void emit_procs(OutBuf *b, const PInfo *old, int no, const PInfo *cur,
+                       int nc, int pass) {
+  bool first = true;
+  size_t count_at = b->n;
+  uint32_t count = 0;
+  if (out_fmt == OUT_BIN)
+    ob_le(b, 0, 4);
+  else
+    ob_printf(b, ",\"%s\":[",
+              pass == PASS_NEW ? "new" : pass == PASS_CHG ? "chg" : "exit");
+
+  int i = 0, j = 0;
+  while (i < no || j < nc) {
+    if (j < nc && (i == no || cur[j].pid < old[i].pid)) {
+      if (pass == PASS_NEW) {
+        if (out_fmt == OUT_BIN)
+          emit_new_bin(b, &cur[j]);
+        else
+          emit_new_json(b, &cur[j], &first);
+        count++;
+      }
+      j++;
+    } else if (i < no && (j == nc || old[i].pid < cur[j].pid)) {
+      if (pass == PASS_EXIT) {
+        if (out_fmt == OUT_BIN)
+          ob_le(b, (uint32_t)old[i].pid, 4);
+        else
+          ob_printf(b, "%s%d", first ? "" : ",", (int)old[i].pid);
+        first = false;
+        count++;
+      }
+      i++;
+    } else {
+      unsigned m = pass == PASS_CHG ? pinfo_delta(&old[i], &cur[j]) : 0;
+      if (m) {
+        if (out_fmt == OUT_BIN)
+          emit_chg_bin(b, &cur[j], m);
+        else
+          emit_chg_json(b, &cur[j], m, &first);
+        count++;
+      }
+      i++;
+      j++;
+    }
+  }
+
+  if (out_fmt == OUT_BIN) {
+    for (int k = 0; k < 4; k++)
+      b->p[count_at + k] = (char)(count >> (8 * k));
+  } else {
+    ob_put(b, "]", 1);
+  }
+}
+
+static void emit_prof(OutBuf *b, const ProfSnap *ps) {
+  if (out_fmt == OUT_BIN) {
+    ob_le(b, NPS, 1);
+    for (int i = 0; i < NPS; i++) {
+      ob_le(b, ps->stage[i].p50, 4);
+      ob_le(b, ps->stage[i].p99, 4);
+    }
+    ob_f32(b, ps->cpu_pct);
+    ob_le(b, ps->rss_kb, 8);
+    ob_le(b, ps->syscalls, 8);
+    ob_le(b, ps->read_bytes, 8);
+    ob_le(b, (uint64_t)ps->interval_ms, 4);
+    return;
+  }
+  ob_printf(b, ",\"prof\":{");
+  for (int i = 0; i < NPS; i++)
+    ob_printf(b, "\"%s\":{\"p50_us\":%.1f,\"p99_us\":%.1f},", ps_name[i],
+              ps->stage[i].p50 / 1e3, ps->stage[i].p99 / 1e3);
+  ob_printf(b,
+            "\"cpu_pct\":%.2f,\"rss_kb\":%lu,\"syscalls\":%llu,"
+            "\"read_bytes\":%llu,\"interval_ms\":%ld}",
+            ps->cpu_pct, ps->rss_kb, ps->syscalls, ps->read_bytes,
+            ps->interval_ms);
+}
+
+static void emit_record(OutBuf *b, uint32_t seq, const PInfo *old, int no,
+                        const PInfo *cur, int nc, const ProfSnap *ps) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  uint64_t t_ms = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+  int ncores = cpu.ncores < MAX_CORES ? cpu.ncores : MAX_CORES;
+  unsigned long mv[7] = {mem.total_kb,      mem.free_kb,  mem.avail_kb,
+                         mem.buffers_kb,    mem.cached_kb, mem.swap_total_kb,
+                         mem.swap_free_kb};
+  static const char *mk[7] = {"total_kb",   "free_kb",       "avail_kb",
+                              "buffers_kb", "cached_kb",     "swap_total_kb",
+                              "swap_free_kb"};
+
+  b->n = 0;
+  b->bad = false;
+  if (out_fmt == OUT_BIN) {
+    ob_le(b, 0, 4);
+    ob_le(b, ps ? 2 : 1, 1);
+    ob_le(b, t_ms, 8);
+    ob_le(b, seq, 4);
+    ob_le(b, (uint64_t)ncores, 2);
+    ob_f32(b, cpu.total);
+    for (int i = 0; i < ncores; i++)
+      ob_f32(b, cpu.core[i]);
+    for (int i = 0; i < ncores; i++)
+      ob_f32(b, sens.freq_mhz[i]);
+    ob_f32(b, sens.temp_c);
+    for (int i = 0; i < 7; i++)
+      ob_le(b, mv[i], 8);
+    ob_le(b, (uint64_t)nc, 4);
+  } else {
+    ob_printf(b, "{\"t\":%llu,\"seq\":%u,\"cpu\":{\"total\":%.4f,\"cores\":[",
+              (unsigned long long)t_ms, seq, cpu.total);
+    for (int i = 0; i < ncores; i++)
+      ob_printf(b, "%s%.4f", i ? "," : "", cpu.core[i]);
+    ob_printf(b, "]},\"freq_mhz\":[");
+    for (int i = 0; i < ncores; i++)
+      ob_printf(b, "%s%.0f", i ? "," : "", sens.freq_mhz[i]);
+    ob_printf(b, "],\"temp_c\":");
+    if (temp_available)
+      ob_printf(b, "%.1f", sens.temp_c);
+    else
+      ob_printf(b, "null");
+    ob_printf(b, ",\"mem\":{");
+    for (int i = 0; i < 7; i++)
+      ob_printf(b, "%s\"%s\":%lu", i ? "," : "", mk[i], mv[i]);
+    ob_printf(b, "},\"nprocs\":%d", nc);
+  }
 
-  memset(procs, 0, sizeof(procs));
-  nprocs = 0;
+  emit_procs(b, old, no, cur, nc, PASS_NEW);
+  emit_procs(b, old, no, cur, nc, PASS_CHG);
+  emit_procs(b, old, no, cur, nc, PASS_EXIT);
+  if (ps)
+    emit_prof(b, ps);
+
+  if (b->bad)
+    return; // headless_run() drops the record
+  if (out_fmt == OUT_BIN) {
+    uint32_t len = (uint32_t)(b->n - 4);
+    for (int k = 0; k < 4; k++)
+      b->p[k] = (char)(len >> (8 * k));
+  } else {
+    ob_put(b, "}\n", 2);
+  }
+}
+
+static bool write_all(int fd, const char *p, size_t n) {
+  while (n > 0) {
+    ssize_t w = write(fd, p, n);
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w <= 0)
+      return false;
+    p += w;
+    n -= (size_t)w;
+  }
+  return true;
+}
+
+static void hl_on_signal(int sig) {
+  (void)sig;
+  hl_stop = 1;
+}
+
+static int headless_run(void) {
+  int fd = STDOUT_FILENO;
+  if (out_path) {
+    fd = open(out_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      fprintf(stderr, "neotop: %s: %s\n", out_path, strerror(errno));
+      return 1;
+    }
+  }
+  int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  if (tfd < 0) {
+    fprintf(stderr, "neotop: cannot create interval timer\n");
+    return 1;
+  }
+
+  struct sigaction sa = {0};
+  sa.sa_handler = hl_on_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  pool_start();
+  cpu_sample();
+  push_mem_hist();
+  usleep(100000);
+  timer_arm(tfd, out_ms);
+
+  OutBuf ob = {0};
+  PInfo *prev = NULL;
+  int nprev = 0;
+  uint32_t seq = 0;
+  int rc = 0;
+  while (!hl_stop) {
+    cpu_sample();
+    push_mem_hist();
+    hist_record();
+    sensors_sample();
+    scan_processes();
+
+    // Sort a private copy by PID; it is also next interval's baseline.
+    const ProcBuf *t = cur_tab;
+    int n = t ? t->n : 0;
+    PInfo *curv = malloc((size_t)(n ? n : 1) * sizeof(PInfo));
+    if (!curv) {
+      rc = 1;
+      break;
+    }
+    if (n)
+      memcpy(curv, t->v, (size_t)n * sizeof(PInfo));
+    qsort(curv, (size_t)n, sizeof(PInfo), cmp_pinfo_pid);
+
+    ProfSnap ps = {0};
+    bool with_prof = atomic_load(&prof_on);
+    if (with_prof)
+      prof_collect(&ps);
+    emit_record(&ob, seq++, prev, nprev, curv, n, with_prof ? &ps : NULL);
+    if (ob.bad) {
+      // Out of memory mid-record: nothing is written and the baseline stays,
+      // so the next record's delta still applies to what readers have. The
+      // gap in seq shows the loss.
+      free(curv);
+    } else if (!write_all(fd, ob.p, ob.n)) {
+      rc = errno == EPIPE ? 0 : 1;
+      free(curv);
+      break;
+    } else {
+      free(prev);
+      prev = curv;
+      nprev = n;
+    }
+
+    uint64_t ticks;
+    while (!hl_stop && read(tfd, &ticks, sizeof(ticks)) < 0 && errno == EINTR)
+      ;
+  }
+  free(prev);
+  free(ob.p);
+  pool_stop();
+  if (out_path)
+    close(fd);
+  return rc;
+}
+
+// ---------- Remote Protocol ----------
+// With -l the collectors run headless and serve a stream instead of writing
+// records. -C points the UI at one or more such daemons instead of the
+// local sampler. One daemon samples once per interval for any number of
+// viewers. Every viewer gets the same delta frame, and a viewer that just
+// connected gets one keyframe first, so bandwidth follows the change rate
+// and not the process count.
+//
+// Addresses are "unix:/path" (or any path with a '/'), "host:port", or a bare
+// port, which means 127.0.0.1. The stream has no authentication. Bind a TCP
+// daemon to a wider address only on a network where that is acceptable.
+//
+// Stream: the 8-byte magic, then frames. A frame is a varint payload length
+// and the payload. Unsigned values are LEB128 varints ("uv"); signed values
+// are zigzag varints ("sv").
+//   u8 kind ('K' keyframe, 'D' delta) uv seq uv t_ms [K: uv len host[len]]
+//   uv ncores  sv sys[n]: the system values of wire_pack() minus those of the
+//              previous frame (zero-based in a keyframe)
+//   uv nnew  { uv dpid uv uid uv len user uv len comm uv cpu_x10 uv rss_kb
+//              sv nice u8 flags uv threads }
+//   uv nchg  { uv dpid u8 mask [uid user][comm][cpu_x10][rss_kb][nice]
+//              [flags][threads] }
+//   uv nexit { uv dpid }
+// PIDs ascend within a list and dpid is the gap to the previous one. flags
+// holds running, suspended_by_manager and the CLS_* bits.
+#define REMOTE_MAGIC "NEOTOPR1"
+#define REMOTE_MAX 8
+#define SRV_CLIENTS 32
+#define SRV_BACKLOG (4u << 20) // unsent bytes before a viewer is dropped
+#define REMOTE_RETRY_MS 2000
+#define WIRE_NSYS(nc) (1 + (nc) * (NCAT + 2) + NCAT + 10 + NPSI * 4)
+
+enum { WD_FLAGS = D_RUN, WD_THR = 32, WD_USER = 64 };
+
+static const char *serve_addr = NULL;
+static const char *remote_addrs[REMOTE_MAX];
+static int nremote_addrs = 0;
+
+typedef struct {
+  int ncores, n;
+  int64_t v[WIRE_NSYS(MAX_CORES)];
+} WireSys;
+
+static void ob_uv(OutBuf *b, uint64_t v) {
+  unsigned char t[10];
+  size_t n = 0;
+  do {
+    t[n] = (unsigned char)(v & 0x7f);
+    v >>= 7;
+    if (v)
+      t[n] |= 0x80;
+    n++;
+  } while (v);
+  ob_put(b, t, n);
+}
+
+static void ob_sv(OutBuf *b, int64_t v) {
+  ob_uv(b, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static void ob_str(OutBuf *b, const char *s, size_t max) {
+  size_t len = strnlen(s, max);
+  ob_uv(b, len);
+  ob_put(b, s, len);
+}
+
+typedef struct {
+  const unsigned char *p, *end;
+  bool bad;
+} InBuf;
+
+static uint64_t ib_uv(InBuf *b) {
+  uint64_t v = 0;
+  for (int sh = 0; sh < 64 && b->p < b->end; sh += 7) {
+    unsigned c = *b->p++;
+    v |= (uint64_t)(c & 0x7f) << sh;
+    if (!(c & 0x80))
+      return v;
+  }
+  b->bad = true;
+  return 0;
+}
+
+// A record count off the wire. Every record takes at least a byte, so a
+// count above what is left of the frame marks it corrupt.
+static int ib_count(InBuf *b, uint64_t v) {
+  if (v > (uint64_t)(b->end - b->p)) {
+    b->bad = true;
+    return 0;
+  }
+  return (int)v;
+}
+
+static int64_t ib_sv(InBuf *b) {
+  uint64_t u = ib_uv(b);
+  return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+static unsigned ib_u8(InBuf *b) {
+  if (b->p >= b->end) {
+    b->bad = true;
+    return 0;
+  }
+  return *b->p++;
+}
+
+static void ib_str(InBuf *b, char *out, size_t cap) {
+  uint64_t n = ib_uv(b);
+  if (n > (uint64_t)(b->end - b->p)) {
+    b->bad = true;
+    n = 0;
+  }
+  size_t k = n < cap - 1 ? (size_t)n : cap - 1;
+  memcpy(out, b->p, k);
+  out[k] = '\0';
+  b->p += n;
+}
+
+// The system metrics as one flat vector of fixed-point integers, so that a
+// frame can send each one as a difference that is usually 0 or tiny.
+static void wire_pack(WireSys *w) {
+  int nc = cpu.ncores < MAX_CORES ? cpu.ncores : MAX_CORES, k = 0;
+  w->ncores = nc;
+  w->v[k++] = lround(cpu.total * HIST_SCALE);
+  for (int i = 0; i < nc; i++)
+    w->v[k++] = lround(cpu.core[i] * HIST_SCALE);
+  for (int i = 0; i <= nc; i++)
+    for (int c = 0; c < NCAT; c++)
+      w->v[k++] = cpu.cat[i][c];
+  for (int i = 0; i < nc; i++)
+    w->v[k++] = lround(sens.freq_mhz[i]);
+  w->v[k++] = sens.temp_ok;
+  w->v[k++] = lround(sens.temp_c * 10);
+  unsigned long mv[7] = {mem.total_kb,      mem.free_kb,  mem.avail_kb,
+                         mem.buffers_kb,    mem.cached_kb, mem.swap_total_kb,
+                         mem.swap_free_kb};
+  for (int i = 0; i < 7; i++)
+    w->v[k++] = (int64_t)mv[i];
+  w->v[k++] = psi.ok;
+  for (int r = 0; r < NPSI; r++) {
+    const PsiRes *pr = &psi.res[r];
+    w->v[k++] = pr->some10;
+    w->v[k++] = pr->some60;
+    w->v[k++] = pr->full10;
+    w->v[k++] = pr->full60;
+  }
+  w->n = k;
+}
+
+static void wire_unpack(const WireSys *w) {
+  int nc = w->ncores, k = 0;
+  cpu.ncores = nc > 0 ? nc : 1;
+  cpu.total = w->v[k++] / (double)HIST_SCALE;
+  for (int i = 0; i < nc; i++)
+    cpu.core[i] = w->v[k++] / (double)HIST_SCALE;
+  for (int i = 0; i <= nc; i++)
+    for (int c = 0; c < NCAT; c++)
+      cpu.cat[i][c] = (uint16_t)w->v[k++];
+  for (int i = 0; i < nc; i++)
+    sens.freq_mhz[i] = (double)w->v[k++];
+  sens_freq_avg(nc);
+  sens.temp_ok = w->v[k++] != 0;
+  sens.temp_c = w->v[k++] / 10.0;
+  unsigned long *mv[7] = {&mem.total_kb,      &mem.free_kb,
+                          &mem.avail_kb,      &mem.buffers_kb,
+                          &mem.cached_kb,     &mem.swap_total_kb,
+                          &mem.swap_free_kb};
+  for (int i = 0; i < 7; i++)
+    *mv[i] = (unsigned long)w->v[k++];
+  psi.ok = w->v[k++] != 0;
+  for (int r = 0; r < NPSI; r++) {
+    PsiRes *pr = &psi.res[r];
+    pr->some10 = (uint16_t)w->v[k++];
+    pr->some60 = (uint16_t)w->v[k++];
+    pr->full10 = (uint16_t)w->v[k++];
+    pr->full60 = (uint16_t)w->v[k++];
+  }
+}
+
+static unsigned wire_flags(const PInfo *p) {
+  return (unsigned)p->running | (unsigned)p->suspended_by_manager << 1 |
+         (unsigned)p->cls << 2;
+}
+
+static unsigned wire_delta(const PInfo *o, const PInfo *n) {
+  unsigned m = pinfo_delta(o, n) & (D_COMM | D_CPU | D_RSS | D_NICE);
+  if (wire_flags(o) != wire_flags(n))
+    m |= WD_FLAGS;
+  if (o->threads != n->threads)
+    m |= WD_THR;
+  if (o->uid != n->uid)
+    m |= WD_USER;
+  return m;
+}
+
+static void wire_new(OutBuf *b, const PInfo *p) {
+  ob_uv(b, p->uid);
+  ob_str(b, p->user ? p->user : "unknown", 64);
+  ob_str(b, p->comm, MAX_COMM - 1);
+  ob_uv(b, (uint64_t)llround(fmax(p->cpu_pct, 0) * 10));
+  ob_uv(b, p->rss_kb);
+  ob_sv(b, p->nicev);
+  ob_uv(b, wire_flags(p));
+  ob_uv(b, (uint64_t)(p->threads > 0 ? p->threads : 0));
+}
 
-  DIR *d = opendir("/proc");
-  if (!d)
-    return;
+static void wire_chg(OutBuf *b, const PInfo *p, unsigned m) {
+  ob_uv(b, m);
+  if (m & WD_USER) {
+    ob_uv(b, p->uid);
+    ob_str(b, p->user ? p->user : "unknown", 64);
+  }
+  if (m & D_COMM)
+    ob_str(b, p->comm, MAX_COMM - 1);
+  if (m & D_CPU)
+    ob_uv(b, (uint64_t)llround(fmax(p->cpu_pct, 0) * 10));
+  if (m & D_RSS)
+    ob_uv(b, p->rss_kb);
+  if (m & D_NICE)
+    ob_sv(b, p->nicev);
+  if (m & WD_FLAGS)
+    ob_uv(b, wire_flags(p));
+  if (m & WD_THR)
+    ob_uv(b, (uint64_t)(p->threads > 0 ? p->threads : 0));
+}
 
-  struct dirent *e;
-  while ((e = readdir(d)) && nprocs < MAX_PROCS) {
-    if (!is_pid_dir(e->d_name))
+// One list of a frame, the same merge walk as emit_procs(). Items go to a
+// scratch buffer first because the count precedes them.
+static void wire_procs(OutBuf *b, const PInfo *old, int no, const PInfo *cur,
+                       int nc, int pass) {
+  static OutBuf tmp;
+  tmp.n = 0;
+  tmp.bad = false;
+  uint64_t count = 0;
+  pid_t last = 0;
+  int i = 0, j = 0;
+  while (i < no || j < nc) {
+    const PInfo *hit = NULL;
+    unsigned m = 0;
+    if (j < nc && (i == no || cur[j].pid < old[i].pid)) {
+      if (pass == PASS_NEW)
+        hit = &cur[j];
+      j++;
+    } else if (i < no && (j == nc || old[i].pid < cur[j].pid)) {
+      if (pass == PASS_EXIT)
+        hit = &old[i];
+      i++;
+    } else {
+      if (pass == PASS_CHG && (m = wire_delta(&old[i], &cur[j])))
+        hit = &cur[j];
+      i++;
+      j++;
+    }
+    if (!hit)
       continue;
+    ob_uv(&tmp, (uint64_t)(hit->pid - last));
+    last = hit->pid;
+    if (pass == PASS_NEW)
+      wire_new(&tmp, hit);
+    else if (pass == PASS_CHG)
+      wire_chg(&tmp, hit, m);
+    count++;
+  }
+  ob_uv(b, count);
+  ob_put(b, tmp.p, tmp.n);
+  b->bad |= tmp.bad;
+}
 
-    pid_t pid = (pid_t)atoi(e->d_name);
-    PInfo *p = &procs[nprocs];
+// Encodes cur against old (NULL/zeros: a keyframe) as a complete frame.
+static void wire_frame(OutBuf *b, uint32_t seq, const WireSys *ws,
+                       const WireSys *wold, const PInfo *old, int no,
+                       const PInfo *cur, int nc) {
+  static OutBuf body;
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  uint64_t t_ms = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+  body.n = 0;
+  body.bad = false;
+  ob_put(&body, wold ? "D" : "K", 1);
+  ob_uv(&body, seq);
+  ob_uv(&body, t_ms);
+  if (!wold)
+    ob_str(&body, host, sizeof(host));
+  ob_uv(&body, (uint64_t)ws->ncores);
+  for (int k = 0; k < ws->n; k++)
+    ob_sv(&body, ws->v[k] - (wold ? wold->v[k] : 0));
+  wire_procs(&body, old, no, cur, nc, PASS_NEW);
+  wire_procs(&body, old, no, cur, nc, PASS_CHG);
+  wire_procs(&body, old, no, cur, nc, PASS_EXIT);
+
+  b->n = 0;
+  b->bad = body.bad;
+  ob_uv(b, body.n);
+  ob_put(b, body.p, body.n);
+}
 
-    p->pid = pid;
-    p->cpu_pct = 0.0;
-    p->running = true;
-    p->suspended_by_manager = false;
+// Fills a socket address from the syntax described at the top of the
+// section. Returns the address family, or -1.
+static int net_addr(const char *spec, struct sockaddr_storage *ss,
+                    socklen_t *len) {
+  memset(ss, 0, sizeof(*ss));
+  if (!strncmp(spec, "unix:", 5) || strchr(spec, '/')) {
+    const char *path = strncmp(spec, "unix:", 5) ? spec : spec + 5;
+    struct sockaddr_un *un = (struct sockaddr_un *)ss;
+    if (strlen(path) >= sizeof(un->sun_path))
+      return -1;
+    un->sun_family = AF_UNIX;
+    strcpy(un->sun_path, path);
+    *len = sizeof(*un);
+    return AF_UNIX;
+  }
+  char hostpart[256] = "127.0.0.1";
+  const char *port = strrchr(spec, ':');
+  if (port) {
+    snprintf(hostpart, sizeof(hostpart), "%.*s", (int)(port - spec), spec);
+    port++;
+  } else {
+    port = spec;
+  }
+  struct addrinfo hints = {.ai_socktype = SOCK_STREAM}, *ai = NULL;
+  if (getaddrinfo(hostpart, port, &hints, &ai) != 0 || !ai)
+    return -1;
+  memcpy(ss, ai->ai_addr, ai->ai_addrlen);
+  *len = ai->ai_addrlen;
+  int fam = ai->ai_family;
+  freeaddrinfo(ai);
+  return fam;
+}
 
-    if (read_comm(pid, p->comm, sizeof(p->comm)) < 0)
-      continue;
-    if (read_stat(pid, &p->ut, &p->st, &p->nicev, &p->running) < 0)
-      continue;
-    read_status(pid, &p->uid, &p->rss_kb);
+typedef struct {
+  int fd;
+  bool live; // has had its keyframe
+  OutBuf out;
+  size_t sent; // bytes of out already written
+} SrvClient;
+
+static SrvClient srv_cl[SRV_CLIENTS];
+static int srv_ncl = 0;
+
+static void srv_drop(int i) {
+  close(srv_cl[i].fd);
+  free(srv_cl[i].out.p);
+  srv_cl[i] = srv_cl[--srv_ncl];
+}
 
-    for (int i = 0; i < prevn; i++) {
-      if (prev[i].pid == pid) {
-        unsigned long dut = (p->ut > prev[i].ut) ? (p->ut - prev[i].ut) : 0;
-        unsigned long dst = (p->st > prev[i].st) ? (p->st - prev[i].st) : 0;
+// Queues a frame and writes as much as the socket takes without blocking.
+static bool srv_send(SrvClient *c, const OutBuf *f) {
+  if (f) {
+    // A frame cut short by a failed allocation would desync the viewer;
+    // dropping it makes the viewer reconnect and start from a keyframe.
+    if (f->bad || c->out.n - c->sent + f->n > SRV_BACKLOG)
+      return false;
+    ob_put(&c->out, f->p, f->n);
+  }
+  if (c->out.bad)
+    return false;
+  while (c->sent < c->out.n) {
+    ssize_t w = send(c->fd, c->out.p + c->sent, c->out.n - c->sent,
+                     MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    if (w <= 0)
+      return false;
+    c->sent += (size_t)w;
+  }
+  // Keep only the unsent tail, so a viewer that never quite catches up
+  // holds at most SRV_BACKLOG bytes rather than everything it was sent.
+  if (c->sent > 0) {
+    memmove(c->out.p, c->out.p + c->sent, c->out.n - c->sent);
+    c->out.n -= c->sent;
+    c->sent = 0;
+  }
+  return true;
+}
 
-        long ticks_per_sec = sysconf(_SC_CLK_TCK);
-        double cpu_time_ms = ((double)(dut + dst) * 1000.0) / ticks_per_sec;
+static int serve_run(void) {
+  struct sockaddr_storage ss;
+  socklen_t sl;
+  int fam = net_addr(serve_addr, &ss, &sl);
+  int lfd = fam < 0 ? -1 : socket(fam, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int one = 1;
+  if (lfd >= 0 && fam != AF_UNIX)
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  if (fam == AF_UNIX)
+    unlink(((struct sockaddr_un *)&ss)->sun_path);
+  if (lfd < 0 || bind(lfd, (struct sockaddr *)&ss, sl) != 0 ||
+      listen(lfd, 16) != 0) {
+    fprintf(stderr, "neotop: cannot listen on %s: %s\n", serve_addr,
+            strerror(errno));
+    return 1;
+  }
+  int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  if (tfd < 0) {
+    fprintf(stderr, "neotop: cannot create interval timer\n");
+    return 1;
+  }
+  struct sigaction sa = {0};
+  sa.sa_handler = hl_on_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
 
-        p->cpu_pct =
-            (time_diff_ms > 0) ? (cpu_time_ms * 100.0 / time_diff_ms) : 0.0;
-        p->suspended_by_manager = prev[i].suspended_by_manager;
+  pool_start();
+  cpu_sample();
+  push_mem_hist();
+  usleep(100000);
+  timer_arm(tfd, out_ms);
+
+  static WireSys ws, wprev;
+  OutBuf key = {0}, delta = {0};
+  PInfo *prev = NULL;
+  int nprev = 0;
+  bool have_prev = false;
+  uint32_t seq = 0;
+  int rc = 0;
+  bool due = true;
+  while (!hl_stop) {
+    if (due) {
+      cpu_sample();
+      push_mem_hist();
+      hist_record();
+      sensors_sample();
+      psi_sample();
+      scan_processes();
+      const ProcBuf *t = cur_tab;
+      int n = t ? t->n : 0;
+      PInfo *curv = malloc((size_t)(n ? n : 1) * sizeof(PInfo));
+      if (!curv) {
+        rc = 1;
         break;
       }
+      if (n)
+        memcpy(curv, t->v, (size_t)n * sizeof(PInfo));
+      qsort(curv, (size_t)n, sizeof(PInfo), cmp_pinfo_pid);
+      wire_pack(&ws);
+
+      // Frames are only built for someone to read them.
+      bool any_live = false, any_new = false;
+      for (int i = 0; i < srv_ncl; i++) {
+        any_live |= srv_cl[i].live;
+        any_new |= !srv_cl[i].live;
+      }
+      bool same = have_prev && ws.ncores == wprev.ncores;
+      if (any_live && same)
+        wire_frame(&delta, seq, &ws, &wprev, prev, nprev, curv, n);
+      if (any_new || (any_live && !same))
+        wire_frame(&key, seq, &ws, NULL, NULL, 0, curv, n);
+      for (int i = srv_ncl - 1; i >= 0; i--) {
+        SrvClient *c = &srv_cl[i];
+        const OutBuf *f = c->live && same ? &delta : &key;
+        if (!srv_send(c, f))
+          srv_drop(i);
+        else
+          c->live = true;
+      }
+      seq++;
+      free(prev);
+      prev = curv;
+      nprev = n;
+      wprev = ws;
+      have_prev = true;
+      due = false;
     }
 
-    nprocs++;
+    struct pollfd pfd[SRV_CLIENTS + 2];
+    pfd[0] = (struct pollfd){.fd = lfd, .events = POLLIN};
+    pfd[1] = (struct pollfd){.fd = tfd, .events = POLLIN};
+    for (int i = 0; i < srv_ncl; i++)
+      pfd[i + 2] = (struct pollfd){
+          .fd = srv_cl[i].fd,
+          .events = POLLIN | (srv_cl[i].out.n ? POLLOUT : 0)};
+    int nfd = srv_ncl + 2;
+    if (poll(pfd, (nfds_t)nfd, -1) < 0)
+      continue; // EINTR: hl_stop is checked above
+    if (pfd[1].revents & POLLIN) {
+      uint64_t ticks;
+      if (read(tfd, &ticks, sizeof(ticks)) > 0)
+        due = true;
+    }
+    // Viewers never send anything; readable means closed.
+    for (int i = nfd - 3; i >= 0; i--) {
+      char junk[64];
+      if ((pfd[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) &&
+          recv(srv_cl[i].fd, junk, sizeof(junk), MSG_DONTWAIT) <= 0)
+        srv_drop(i);
+      else if ((pfd[i + 2].revents & POLLOUT) && !srv_send(&srv_cl[i], NULL))
+        srv_drop(i);
+    }
+    if (pfd[0].revents & POLLIN) {
+      int cfd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+      if (cfd >= 0 && srv_ncl == SRV_CLIENTS) {
+        close(cfd);
+      } else if (cfd >= 0) {
+        SrvClient *c = &srv_cl[srv_ncl++];
+        *c = (SrvClient){.fd = cfd};
+        ob_put(&c->out, REMOTE_MAGIC, 8);
+        if (!srv_send(c, NULL))
+          srv_drop(srv_ncl - 1);
+      }
+    }
   }
-  closedir(d);
+  while (srv_ncl > 0)
+    srv_drop(srv_ncl - 1);
+  if (fam == AF_UNIX)
+    unlink(((struct sockaddr_un *)&ss)->sun_path);
+  close(lfd);
+  free(prev);
+  free(key.p);
+  free(delta.p);
+  pool_stop();
+  return rc;
+}
 
-  memcpy(prev, procs, nprocs * sizeof(PInfo));
-  prevn = nprocs;
-  prev_time_ms = curr_time_ms;
+// Viewer side: a receiver thread takes the sampler's place. It keeps the
+// full state of every daemon and publishes the selected one's through the
+// normal snapshot path, so the pages cannot tell the difference.
+typedef struct {
+  const char *addr;
+  int fd;
+  bool connecting; // fd is an unfinished non-blocking connect
+  bool magic;     // the stream's magic was read
+  bool have;      // a keyframe was applied
+  long long retry; // now_ms() of the next attempt, or the connect deadline
+  int fam;         // resolved address, 0 until net_addr() succeeds
+  struct sockaddr_storage sa;
+  socklen_t salen;
+  unsigned char *in;
+  size_t in_n, in_cap;
+  const char *host; // interned
+  WireSys sys;
+  PInfo *v, *nv; // by PID; nv is the merge target
+  int n, cap, ncap;
+} Remote;
+
+static Remote remotes[REMOTE_MAX];
+static atomic_int remote_sel;
+
+// need is a size_t so a count off the wire cannot overflow on the way in.
+static bool remote_reserve(PInfo **v, int *cap, size_t need) {
+  if (need <= (size_t)*cap)
+    return true;
+  if (need > INT_MAX)
+    return false;
+  size_t nc = *cap ? (size_t)*cap : 512;
+  while (nc < need)
+    nc = nc > INT_MAX / 2 ? need : nc * 2;
+  PInfo *nv = realloc(*v, (size_t)nc * sizeof(PInfo));
+  if (!nv)
+    return false;
+  *v = nv;
+  *cap = (int)nc;
+  return true;
 }
 
-static bool is_priority_proc(const char *comm) {
-  for (int i = 0; i < num_priority_procs; i++) {
-    if (strstr(comm, priority_procs[i]))
-      return true;
+static int cmp_pid_key(const void *key, const void *elem) {
+  pid_t a = *(const pid_t *)key, b = ((const PInfo *)elem)->pid;
+  return (a > b) - (a < b);
+}
+
+static void remote_close(Remote *r) {
+  if (r->fd >= 0)
+    close(r->fd);
+  r->fd = -1;
+  r->connecting = r->magic = r->have = false;
+  r->in_n = 0;
+  r->retry = now_ms() + REMOTE_RETRY_MS;
+}
+
+// Starts a non-blocking connect. An unfinished one stays in remote_main()'s
+// poll set for POLLOUT until r->retry, so a dead host does not hold up the
+// others for a TCP timeout. The name is resolved once and cached; only a
+// name that has never resolved is looked up again on later attempts.
+static void remote_connect(Remote *r) {
+  if (r->fam <= 0)
+    r->fam = net_addr(r->addr, &r->sa, &r->salen);
+  int fd = r->fam < 0 ? -1
+                      : socket(r->fam,
+                               SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    remote_close(r);
+    return;
   }
-  return false;
-}
-
-static bool is_system_critical(const char *comm) {
-  static const char *critical[] = {"systemd",
-                                   "init",
-                                   "kernel",
-                                   "kthread",
-                                   "ksoftirq",
-                                   "kworker",
-                                   "Xorg",
-                                   "X",
-                                   "wayland",
-                                   "sway",
-                                   "gnome-shell",
-                                   "kwin",
-                                   "mutter",
-                                   "plasmashell",
-                                   "xfwm4",
-                                   "openbox",
-                                   "i3",
-                                   "dwm",
-                                   "awesome",
-                                   "gdm",
-                                   "sddm",
-                                   "lightdm",
-                                   "login",
-                                   "getty",
-                                   "pulseaudio",
-                                   "pipewire",
-                                   "wireplumber",
-                                   "alsa",
-                                   "NetworkManager",
-                                   "wpa_supplicant",
-                                   "dhclient",
-                                   "dhcpcd",
-                                   "dbus",
-                                   "dbus-daemon",
-                                   "systemd-",
-                                   "udevd",
-                                   "upowerd",
-                                   "polkitd",
-                                   "rtkit",
-                                   "accounts-daemon",
-                                   "udisksd",
-                                   "bluetoothd",
-                                   "cupsd",
-                                   "avahi",
-                                   "ssh",
-                                   "sshd",
-                                   "cron",
-                                   "crond",
-                                   "atd",
-                                   "rsyslogd",
-                                   "syslog",
-                                   "journald",
-                                   "dockerd",
-                                   "containerd",
-                                   "kubelet",
-                                   "libvirtd",
-                                   "virtlogd",
-                                   "qemu",
-                                   "xfce4-session",
-                                   "mate-session",
-                                   "cinnamon-session",
-                                   "lxsession",
-                                   "lxqt-session",
-                                   "gnome-session",
-                                   "kde-session",
-                                   NULL};
-
-  for (int i = 0; critical[i] != NULL; i++) {
-    if (strstr(comm, critical[i]))
-      return true;
+  r->fd = fd;
+  if (connect(fd, (struct sockaddr *)&r->sa, r->salen) == 0) {
+    r->connecting = false;
+  } else if (errno == EINPROGRESS) {
+    r->connecting = true;
+    r->retry = now_ms() + REMOTE_RETRY_MS;
+  } else {
+    remote_close(r);
   }
+}
 
-  return false;
+// Called once the connecting fd polls writable.
+static void remote_connected(Remote *r) {
+  int err = 0;
+  socklen_t el = sizeof(err);
+  if (getsockopt(r->fd, SOL_SOCKET, SO_ERROR, &err, &el) != 0 || err)
+    remote_close(r);
+  else
+    r->connecting = false;
 }
 
-static void manage_resources(void) {
-  if (!auto_manage_enabled)
-    return;
+// Applies a decoded frame's rows: r->v holds the old rows with exits marked
+// pid 0, and the nnew new rows sit in r->nv past r->n. Old survivors and the
+// new rows are merged into a scratch table, which then replaces r->v.
+static bool remote_merge(Remote *r, int nnew) {
+  static PInfo *merged = NULL;
+  static int merged_cap = 0;
+  const PInfo *fresh = r->nv + r->n;
+  if (!remote_reserve(&merged, &merged_cap, (size_t)r->n + (size_t)nnew))
+    return false;
+  int i = 0, j = 0, k = 0;
+  while (i < r->n || j < nnew) {
+    if (i < r->n && !r->v[i].pid) {
+      i++;
+    } else if (j == nnew || (i < r->n && r->v[i].pid < fresh[j].pid)) {
+      merged[k++] = r->v[i++];
+    } else {
+      if (i < r->n && r->v[i].pid == fresh[j].pid)
+        i++; // a keyframe or a repeat replaces the old row
+      merged[k++] = fresh[j++];
+    }
+  }
+  if (!remote_reserve(&r->v, &r->cap, k))
+    return false;
+  memcpy(r->v, merged, (size_t)k * sizeof(PInfo));
+  r->n = k;
+  return true;
+}
 
-  bool priority_running = false;
-  for (int i = 0; i < nprocs; i++) {
-    if (is_priority_proc(procs[i].comm) && procs[i].running) {
-      priority_running = true;
-      break;
+static bool remote_apply(Remote *r, InBuf *b) {
+  unsigned kind = ib_u8(b);
+  ib_uv(b); // seq
+  ib_uv(b); // t_ms
+  if (kind == 'K') {
+    char name[64];
+    ib_str(b, name, sizeof(name));
+    r->host = intern_name(name);
+  } else if (kind != 'D' || !r->have) {
+    return false;
+  }
+  int nc = (int)ib_uv(b);
+  if (nc < 0 || nc > MAX_CORES || (kind == 'D' && nc != r->sys.ncores))
+    return false;
+  WireSys *w = &r->sys;
+  w->ncores = nc;
+  w->n = WIRE_NSYS(nc);
+  for (int k = 0; k < w->n; k++)
+    w->v[k] = (kind == 'K' ? 0 : w->v[k]) + ib_sv(b);
+  if (kind == 'K')
+    r->n = 0;
+
+  // New rows are decoded straight into the merge target's tail and merged
+  // in after the changes and exits were applied to the old rows.
+  int nnew = ib_count(b, ib_uv(b));
+  if (b->bad || !remote_reserve(&r->nv, &r->ncap, (size_t)r->n + (size_t)nnew))
+    return false;
+  PInfo *fresh = r->nv + r->n;
+  pid_t pid = 0;
+  for (int i = 0; i < nnew && !b->bad; i++) {
+    PInfo *p = &fresh[i];
+    char user[64];
+    *p = (PInfo){0};
+    pid += (pid_t)ib_uv(b);
+    p->pid = pid;
+    p->uid = (uid_t)ib_uv(b);
+    ib_str(b, user, sizeof(user));
+    p->user = intern_name(user);
+    ib_str(b, p->comm, sizeof(p->comm));
+    p->cpu_pct = ib_uv(b) / 10.0;
+    p->rss_kb = (unsigned long)ib_uv(b);
+    p->nicev = (int)ib_sv(b);
+    unsigned f = (unsigned)ib_uv(b);
+    p->running = f & 1;
+    p->suspended_by_manager = f >> 1 & 1;
+    p->cls = (unsigned char)(f >> 2);
+    p->threads = (int)ib_uv(b);
+  }
+  int nchg = ib_count(b, ib_uv(b));
+  pid = 0;
+  for (int i = 0; i < nchg && !b->bad; i++) {
+    pid += (pid_t)ib_uv(b);
+    unsigned m = (unsigned)ib_uv(b);
+    PInfo *p = bsearch(&pid, r->v, (size_t)r->n, sizeof(PInfo), cmp_pid_key);
+    PInfo dummy;
+    if (!p)
+      p = &dummy; // still consumed, the frame stays in step
+    if (m & WD_USER) {
+      char user[64];
+      p->uid = (uid_t)ib_uv(b);
+      ib_str(b, user, sizeof(user));
+      p->user = intern_name(user);
     }
+    if (m & D_COMM)
+      ib_str(b, p->comm, sizeof(p->comm));
+    if (m & D_CPU)
+      p->cpu_pct = ib_uv(b) / 10.0;
+    if (m & D_RSS)
+      p->rss_kb = (unsigned long)ib_uv(b);
+    if (m & D_NICE)
+      p->nicev = (int)ib_sv(b);
+    if (m & WD_FLAGS) {
+      unsigned f = (unsigned)ib_uv(b);
+      p->running = f & 1;
+      p->suspended_by_manager = f >> 1 & 1;
+      p->cls = (unsigned char)(f >> 2);
+    }
+    if (m & WD_THR)
+      p->threads = (int)ib_uv(b);
+  }
+  // Exits mark their rows with pid 0; the merge drops those.
+  int nexit = ib_count(b, ib_uv(b));
+  pid = 0;
+  for (int i = 0; i < nexit && !b->bad; i++) {
+    pid += (pid_t)ib_uv(b);
+    PInfo *p = bsearch(&pid, r->v, (size_t)r->n, sizeof(PInfo), cmp_pid_key);
+    if (p)
+      p->pid = 0;
   }
+  if (b->bad || b->p != b->end || !remote_merge(r, nnew))
+    return false;
+  r->have = true;
+  return true;
+}
 
-  if (!priority_running)
-    return;
+// Turns the selected daemon's state into a snapshot. The table copy is the
+// one per-frame pass over every row, the same cost as a local scan's merge.
+static void remote_publish(const Remote *r) {
+  static const char *shown = NULL;
+  const char *want = r->have ? r->host : NULL;
+  if (want != shown) {
+    hist_n = hpos = 0; // a history would mix two machines
+    memset(hist_mem, 0, sizeof(hist_mem));
+    shown = want;
+  }
+  if (!r->have) {
+    // Nothing from a down daemon, rather than the last one's numbers.
+    cpu = (CpuSnap){.ncores = 1};
+    mem = (MemSnap){0};
+    sens = (SensorSnap){0};
+    psi = (PsiSnap){0};
+    core_hist = (CoreHist){0};
+    ProcBuf *t = tab_acquire();
+    if (t) {
+      t->n = t->ng = 0;
+      cur_tab = t;
+      tab_seq++;
+    }
+    nprocs = n_suspended = 0;
+  } else {
+    wire_unpack(&r->sys);
+    push_hist();
+    mem_hist_add();
+    hist_reduce(&core_hist);
+    ProcBuf *t = tab_acquire();
+    if (t && remote_reserve(&t->v, &t->cap, r->n)) {
+      memcpy(t->v, r->v, (size_t)r->n * sizeof(PInfo));
+      t->n = r->n;
+      t->ng = 0;
+      cur_tab = t;
+      tab_seq++;
+      procs = t->v;
+      nprocs = t->n;
+      n_suspended = 0;
+      for (int i = 0; i < t->n; i++)
+        n_suspended += t->v[i].suspended_by_manager;
+    }
+  }
+  // That page describes this machine, whichever daemon is shown.
+  if (page_wants_sysinfo(atomic_load(&ui_page)))
+    sysi_sample();
+  remote_host = r->have ? r->host : r->addr;
+  remote_up = r->have;
+  snap_publish();
+}
 
-  for (int i = 0; i < nprocs; i++) {
-    if (is_priority_proc(procs[i].comm))
-      continue;
+static bool remote_read(Remote *r) {
+  if (r->in_cap - r->in_n < 65536) {
+    size_t nc = r->in_cap ? r->in_cap * 2 : 131072;
+    unsigned char *np = realloc(r->in, nc);
+    if (!np)
+      return false;
+    r->in = np;
+    r->in_cap = nc;
+  }
+  ssize_t n = recv(r->fd, r->in + r->in_n, r->in_cap - r->in_n, 0);
+  if (n < 0 && (errno == EAGAIN || errno == EINTR))
+    return true;
+  if (n <= 0)
+    return false;
+  r->in_n += (size_t)n;
+  return true;
+}
 
-    if (is_system_critical(procs[i].comm))
-      continue;
+// Applies every complete frame in the input buffer; false on a bad stream.
+static bool remote_drain(Remote *r, bool *applied) {
+  size_t off = 0;
+  if (!r->magic) {
+    if (r->in_n < 8)
+      return true;
+    if (memcmp(r->in, REMOTE_MAGIC, 8) != 0)
+      return false;
+    r->magic = true;
+    off = 8;
+  }
+  for (;;) {
+    InBuf hdr = {r->in + off, r->in + r->in_n, false};
+    uint64_t len = ib_uv(&hdr);
+    if (hdr.bad || (uint64_t)(hdr.end - hdr.p) < len)
+      break; // incomplete
+    InBuf body = {hdr.p, hdr.p + len, false};
+    if (!remote_apply(r, &body))
+      return false;
+    *applied = true;
+    off = (size_t)(hdr.p + len - r->in);
+  }
+  memmove(r->in, r->in + off, r->in_n - off);
+  r->in_n -= off;
+  return true;
+}
 
-    if (procs[i].uid == 0)
-      continue;
+static void *remote_main(void *arg) {
+  (void)arg;
+  int nr = nremote_addrs, shown = -1;
+  for (int i = 0; i < nr; i++)
+    remotes[i] = (Remote){.addr = remote_addrs[i], .fd = -1};
+  while (!atomic_load(&samp_stop)) {
+    long long now = now_ms();
+    int sel = atomic_load(&remote_sel);
+    bool publish = sel != shown;
+    for (int i = 0; i < nr; i++) {
+      Remote *r = &remotes[i];
+      if (r->connecting && now >= r->retry)
+        remote_close(r); // timed out
+      if (r->fd < 0 && now >= r->retry)
+        remote_connect(r);
+    }
 
-    if ((procs[i].cpu_pct > 10.0 || procs[i].rss_kb > 500000) &&
-        procs[i].running && !procs[i].suspended_by_manager) {
-      if (kill(procs[i].pid, SIGSTOP) == 0) {
-        procs[i].suspended_by_manager = true;
-      }
+    struct pollfd pfd[REMOTE_MAX + 1];
+    pfd[0] = (struct pollfd){.fd = samp_evfd, .events = POLLIN};
+    long long wake = now + REMOTE_RETRY_MS;
+    for (int i = 0; i < nr; i++) {
+      Remote *r = &remotes[i];
+      pfd[i + 1] = (struct pollfd){
+          .fd = r->fd, .events = r->connecting ? POLLOUT : POLLIN};
+      if ((r->fd < 0 || r->connecting) && r->retry < wake)
+        wake = r->retry;
     }
-  }
-}
+    poll(pfd, (nfds_t)nr + 1, wake > now ? (int)(wake - now) : 0);
+    evfd_drain(samp_evfd);
 
-static void resume_suspended(void) {
-  for (int i = 0; i < nprocs; i++) {
-    if (procs[i].suspended_by_manager) {
-      kill(procs[i].pid, SIGCONT);
-      procs[i].suspended_by_manager = false;
+    for (int i = 0; i < nr; i++) {
+      Remote *r = &remotes[i];
+      if (r->fd < 0 || !pfd[i + 1].revents)
+        continue;
+      if (r->connecting) {
+        remote_connected(r);
+        continue;
+      }
+      if (!(pfd[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+      bool applied = false;
+      if (!remote_read(r) || !remote_drain(r, &applied)) {
+        remote_close(r);
+        applied = true; // shows the host as down
+      }
+      publish |= applied && i == sel;
+    }
+    if (publish) {
+      remote_publish(&remotes[sel]);
+      shown = sel;
     }
   }
+  for (int i = 0; i < nr; i++)
+    if (remotes[i].fd >= 0)
+      close(remotes[i].fd);
+  return NULL;
 }
 
-static int cmp_cpu(const void *a, const void *b) {
-  const PInfo *x = a, *y = b;
-  if (y->cpu_pct > x->cpu_pct)
-    return 1;
-  if (y->cpu_pct < x->cpu_pct)
-    return -1;
-  return (int)(x->pid - y->pid);
+// ---------- UI helpers ----------
+static void fmt_ns(char *out, size_t n, uint32_t ns) {
+  if (ns < 1000)
+    snprintf(out, n, "%uns", ns);
+  else if (ns < 1000000)
+    snprintf(out, n, "%.1fus", ns / 1e3);
+  else
+    snprintf(out, n, "%.2fms", ns / 1e6);
 }
 
-static int cmp_mem(const void *a, const void *b) {
-  const PInfo *x = a, *y = b;
-  if (y->rss_kb > x->rss_kb)
-    return 1;
-  if (y->rss_kb < x->rss_kb)
-    return -1;
-  return (int)(x->pid - y->pid);
+static void fmt_rate(char *out, size_t n, double v) {
+  if (v >= 1e6)
+    snprintf(out, n, "%.1fM", v / 1e6);
+  else if (v >= 1e3)
+    snprintf(out, n, "%.1fk", v / 1e3);
+  else
+    snprintf(out, n, "%.0f", v);
 }
 
-// ---------- UI helpers ----------
 static void draw_box(int y, int x, int h, int w) {
   attron(COLOR_PAIR(C_WHITE));
   mvaddch(y, x, ACS_ULCORNER);
@@ -786,61 +5526,502 @@ static int get_color(double ratio) {
   return C_GREEN;
 }
 
-static void draw_vert_bar(int y, int x, int h, double ratio, int col) {
-  if (h <= 0)
+static void draw_vert_bar(int y, int x, int h, double ratio, int col) {
+  if (h <= 0)
+    return;
+  if (ratio < 0.0)
+    ratio = 0.0;
+  if (ratio > 1.0)
+    ratio = 1.0;
+
+  double exact_fill = ratio * h;
+  int full_blocks = (int)exact_fill;
+  double fractional = exact_fill - full_blocks;
+
+  attron(COLOR_PAIR(C_DIM_WHITE));
+  for (int i = 0; i < h; i++) {
+    mvaddch(y + h - 1 - i, x, ACS_CKBOARD);
+  }
+  attroff(COLOR_PAIR(C_DIM_WHITE));
+
+  attron(COLOR_PAIR(col) | A_BOLD);
+  for (int i = 0; i < full_blocks; i++) {
+    mvaddch(y + h - 1 - i, x, ACS_CKBOARD);
+  }
+  attroff(COLOR_PAIR(col) | A_BOLD);
+
+  if (full_blocks < h && fractional > 0.25) {
+    attron(COLOR_PAIR(col));
+    mvaddch(y + h - 1 - full_blocks, x, ACS_CKBOARD);
+    attroff(COLOR_PAIR(col));
+  }
+}
+
+static int get_start_x(int width) {
+  if (COLS > width)
+    return (COLS - width) / 2;
+  return 1;
+}
+
+static int get_content_width(void) {
+  if (COLS > CONTENT_WIDTH)
+    return CONTENT_WIDTH;
+  return COLS - 2;
+}
+
+// ---------- Damage Tracking ----------
+// Pages do not erase() and repaint every frame. Each region of a page is a
+// widget whose signature hashes exactly the values it prints; a widget is
+// cleared and redrawn only when its signature moves, and the frame is only
+// flushed when some widget was redrawn. Page changes and resizes drop all
+// signatures and start from a blank screen.
+enum {
+  W_MENU = 0,
+  W_TITLE, // header line that carries live counts
+  W_BODY,  // page text that depends on live state
+  W_BOX0,
+  W_BOX1,
+  W_BOX2,
+  W_BOX3,
+  W_PROF, // self-profile overlay, drawn over whatever page is up
+  W_HOST, // -C: the shown daemon, over the right end of the title row
+  W_ROWS, // one widget per process-table row from here on
+  W_MAX = W_ROWS + 512
+};
+
+#define SIG_INIT 14695981039346656037ull
+
+static uint64_t wsig[W_MAX];
+static bool wvalid[W_MAX];
+static bool frame_dirty = false;
+static int drawn_page = -1, drawn_cols = 0, drawn_lines = 0;
+
+static uint64_t sig_bytes(uint64_t h, const void *p, size_t n) {
+  const unsigned char *b = p;
+  for (size_t i = 0; i < n; i++) {
+    h ^= b[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+static uint64_t sig_int(uint64_t h, long long v) {
+  return sig_bytes(h, &v, sizeof(v));
+}
+
+static uint64_t sig_str(uint64_t h, const char *s) {
+  return sig_bytes(h, s, strlen(s) + 1);
+}
+
+// Returns true when the screen was dropped and the page must draw its
+// static parts again.
+static bool ui_begin(int pg) {
+  if (pg == drawn_page && COLS == drawn_cols && LINES == drawn_lines)
+    return false;
+  erase();
+  memset(wvalid, 0, sizeof(wvalid));
+  drawn_page = pg;
+  drawn_cols = COLS;
+  drawn_lines = LINES;
+  frame_dirty = true;
+  return true;
+}
+
+// Records the widget's new signature; true means the caller must redraw it.
+static bool widget_dirty(int id, uint64_t sig) {
+  if (id >= W_MAX) {
+    frame_dirty = true;
+    return true;
+  }
+  if (wvalid[id] && wsig[id] == sig)
+    return false;
+  wvalid[id] = true;
+  wsig[id] = sig;
+  frame_dirty = true;
+  return true;
+}
+
+static void clear_rect(int y, int x, int h, int w) {
+  for (int i = 0; i < h; i++)
+    mvhline(y + i, x, ' ', w);
+}
+
+static void ui_end(void) {
+  if (frame_dirty)
+    refresh();
+  frame_dirty = false;
+}
+
+// ---------- Pages ----------
+enum {
+  PAGE_MAIN = 0,
+  PAGE_GRAPH,
+  PAGE_SYSINFO,
+  PAGE_HELP,
+  PAGE_ABOUT,
+  PAGE_PROCS,
+  PAGE_RESOURCE_MGR,
+  PAGE_THREADS,
+  NPAGES
+};
+static int page = PAGE_MAIN, menu_sel = 0, proc_sel = 0, sort_mode = 0;
+
+// UI-side profile rings: one per page for draw plus flush, one for sorting.
+static const char *page_name[NPAGES] = {"main",  "graph", "sysinfo",
+                                        "help",  "about", "procs",
+                                        "manager", "threads"};
+static ProfRing prof_draw[NPAGES], prof_sort;
+static bool prof_overlay = false;
+
+static bool page_wants_procs(int pg) {
+  return pg == PAGE_PROCS || pg == PAGE_MAIN || pg == PAGE_RESOURCE_MGR;
+}
+
+static bool page_wants_cpu(int pg) {
+  return pg == PAGE_PROCS || pg == PAGE_GRAPH || pg == PAGE_SYSINFO;
+}
+
+static bool page_wants_sensors(int pg) {
+  return pg == PAGE_GRAPH || pg == PAGE_SYSINFO;
+}
+
+static bool page_wants_core_hist(int pg) { return pg == PAGE_GRAPH; }
+
+static bool page_wants_threads(int pg) { return pg == PAGE_THREADS; }
+
+static bool page_wants_sysinfo(int pg) { return pg == PAGE_SYSINFO; }
+
+static bool page_wants_ext(int pg) {
+  return pg == PAGE_PROCS && atomic_load(&ext_cols);
+}
+
+// ---------- Process View ----------
+// draw_procs() reads the snapshot's process table through per-key index
+// arrays. An order is rebuilt only when a new table arrives, and only as far
+// as needed: idx[0..k) is sorted and holds the k first rows, everything after
+// k is unordered. Scrolling further extends k with another partial select.
+enum {
+  SORT_CPU = 0,
+  SORT_MEM,
+  SORT_PID,
+  SORT_NAME,
+  SORT_USER,
+  SORT_IO,
+  SORT_CSW,
+  SORT_THR,
+  NSORT
+};
+
+typedef struct {
+  int *idx;
+  int k; // -1 = idx not initialised for the current table
+  int cap;
+} SortOrder;
+
+static int (*const sort_cmp[NSORT])(const void *, const void *) = {
+    cmp_cpu, cmp_mem, cmp_pid, cmp_name, cmp_user, cmp_io, cmp_csw, cmp_thr};
+
+static const Snapshot *snap = &snaps[2];
+static const PInfo *view = NULL;
+static int view_n = 0;
+static unsigned long ui_tab_seq = 0;
+static SortOrder orders[NSORT];
+static pid_t sel_pid = 0;
+
+// Grouped view: with 'g' the list holds one row per cgroup carrying the
+// sampler's per-group sums, each followed, once opened with Enter, by its
+// processes in the current sort order. proc_sel then indexes grows.
+typedef struct {
+  int grp; // 1-based cgroup index
+  int pi;  // row in view, -1 for the group row itself
+} GRow;
+
+static bool grouped = false;
+static bool grows_stale = true;
+static unsigned char grp_open[GRP_MAX];
+static GRow *grows = NULL;
+static int ngrows = 0, grows_cap = 0;
+static int sel_grp = 0;
+
+static const PInfo *ord_base;
+static int (*ord_cmp)(const void *, const void *);
+
+static int cmp_idx(const void *a, const void *b) {
+  return ord_cmp(&ord_base[*(const int *)a], &ord_base[*(const int *)b]);
+}
+
+static void swap_int(int *a, int *b) {
+  int t = *a;
+  *a = *b;
+  *b = t;
+}
+
+// Quickselect: reorders v so its first k elements are the k smallest.
+static void select_k(int *v, int n, int k) {
+  int lo = 0, hi = n - 1;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (cmp_idx(&v[mid], &v[lo]) < 0)
+      swap_int(&v[mid], &v[lo]);
+    if (cmp_idx(&v[hi], &v[lo]) < 0)
+      swap_int(&v[hi], &v[lo]);
+    if (cmp_idx(&v[hi], &v[mid]) < 0)
+      swap_int(&v[hi], &v[mid]);
+    int pivot = v[mid];
+    int i = lo, j = hi;
+    while (i <= j) {
+      while (cmp_idx(&v[i], &pivot) < 0)
+        i++;
+      while (cmp_idx(&pivot, &v[j]) < 0)
+        j--;
+      if (i <= j)
+        swap_int(&v[i++], &v[j--]);
+    }
+    if (k - 1 <= j)
+      hi = j;
+    else if (k - 1 >= i)
+      lo = i;
+    else
+      break;
+  }
+}
+
+static const int *order_ensure(int key, int k) {
+  SortOrder *o = &orders[key];
+  if (o->k < 0) {
+    if (view_n > o->cap) {
+      int *nv = realloc(o->idx, (size_t)view_n * sizeof(int));
+      if (!nv)
+        return NULL;
+      o->idx = nv;
+      o->cap = view_n;
+    }
+    for (int i = 0; i < view_n; i++)
+      o->idx[i] = i;
+    o->k = 0;
+  }
+  // Grow in chunks so scrolling does not trigger a select per keypress.
+  k = (k + 63) & ~63;
+  if (k > view_n)
+    k = view_n;
+  if (k > o->k) {
+    long long t0 = now_ns();
+    ord_base = view;
+    ord_cmp = sort_cmp[key];
+    int rest = view_n - o->k;
+    if (k < view_n)
+      select_k(o->idx + o->k, rest, k - o->k);
+    qsort(o->idx + o->k, (size_t)(k - o->k), sizeof(int), cmp_idx);
+    o->k = k;
+    prof_add(&prof_sort, t0);
+  }
+  return o->idx;
+}
+
+static const PInfo *view_row(int row) {
+  if (row < 0 || row >= view_n)
+    return NULL;
+  const int *idx = order_ensure(sort_mode, row + 1);
+  return idx ? &view[idx[row]] : NULL;
+}
+
+// Puts proc_sel back on sel_pid after the table or the sort key changed.
+static void view_follow_sel(void) {
+  if (grouped) {
+    grows_stale = true; // grows_build() follows the selection
+    return;
+  }
+  if (view_n == 0) {
+    proc_sel = 0;
+    return;
+  }
+  const PInfo *sel = NULL;
+  for (int i = 0; i < view_n; i++) {
+    if (view[i].pid == sel_pid) {
+      sel = &view[i];
+      break;
+    }
+  }
+  if (!sel) {
+    if (proc_sel >= view_n)
+      proc_sel = view_n - 1;
+    const PInfo *p = view_row(proc_sel);
+    sel_pid = p ? p->pid : 0;
+    return;
+  }
+  int rank = 0;
+  for (int i = 0; i < view_n; i++)
+    if (sort_cmp[sort_mode](&view[i], sel) < 0)
+      rank++;
+  proc_sel = rank;
+}
+
+static int list_n(void) { return grouped ? ngrows : view_n; }
+
+// The process on a list row; NULL for group rows.
+static const PInfo *list_proc(int row) {
+  if (!grouped)
+    return view_row(row);
+  if (row < 0 || row >= ngrows || grows[row].pi < 0)
+    return NULL;
+  return &view[grows[row].pi];
+}
+
+static void view_select(int row) {
+  if (row >= list_n())
+    row = list_n() - 1;
+  if (row < 0)
+    row = 0;
+  proc_sel = row;
+  const PInfo *p = list_proc(row);
+  sel_pid = p ? p->pid : 0;
+  if (grouped)
+    sel_grp = row < ngrows ? grows[row].grp : 0;
+}
+
+static const GroupAgg *grp_base;
+
+// Memory orders groups by RSS, the name-like keys by path, the rest by CPU.
+static int cmp_group(const void *a, const void *b) {
+  const GroupAgg *x = &grp_base[*(const int *)a];
+  const GroupAgg *y = &grp_base[*(const int *)b];
+  bool by_path =
+      sort_mode == SORT_PID || sort_mode == SORT_NAME || sort_mode == SORT_USER;
+  if (sort_mode == SORT_MEM && x->rss_kb != y->rss_kb)
+    return x->rss_kb < y->rss_kb ? 1 : -1;
+  if (!by_path && sort_mode != SORT_MEM && x->cpu_pct != y->cpu_pct)
+    return x->cpu_pct < y->cpu_pct ? 1 : -1;
+  return strcmp(x->path, y->path);
+}
+
+static void grows_build(void) {
+  static int *buf = NULL;
+  static size_t buf_cap = 0;
+  grows_stale = false;
+  ngrows = 0;
+  const ProcBuf *t = snap->tab;
+  int ng = t ? t->ng : 0;
+  size_t need = (size_t)ng * 2 + 1 + (size_t)view_n;
+  if (need > buf_cap) {
+    int *nb = realloc(buf, need * sizeof(int));
+    if (!nb)
+      return;
+    buf = nb;
+    buf_cap = need;
+  }
+  if (ng + view_n > grows_cap) {
+    GRow *nr = realloc(grows, (size_t)(ng + view_n) * sizeof(GRow));
+    if (!nr)
+      return;
+    grows = nr;
+    grows_cap = ng + view_n;
+  }
+  // gi: groups with processes, in order; start/mem: the open groups'
+  // members bucketed by group, each bucket in the current process order.
+  int *gi = buf, *start = buf + ng, *mem = start + ng + 1, ngi = 0;
+  bool any_open = false;
+  for (int g = 0; g < ng; g++) {
+    if (t->g[g].nproc > 0) {
+      gi[ngi++] = g;
+      any_open |= grp_open[g];
+    }
+  }
+  grp_base = t ? t->g : NULL;
+  qsort(gi, (size_t)ngi, sizeof(int), cmp_group);
+
+  const int *idx = any_open ? order_ensure(sort_mode, view_n) : NULL;
+  memset(start, 0, (size_t)(ng + 1) * sizeof(int));
+  for (int i = 0; idx && i < view_n; i++) {
+    int g = view[i].grp;
+    if (g && g <= ng && grp_open[g - 1])
+      start[g]++;
+  }
+  for (int g = 0; g < ng; g++)
+    start[g + 1] += start[g];
+  for (int i = 0; idx && i < view_n; i++) {
+    int g = view[idx[i]].grp;
+    if (g && g <= ng && grp_open[g - 1])
+      mem[start[g - 1]++] = idx[i];
+  }
+  // start[g] now ends bucket g, which begins where bucket g - 1 ends.
+  for (int k = 0; k < ngi; k++) {
+    int g = gi[k];
+    grows[ngrows++] = (GRow){g + 1, -1};
+    if (!grp_open[g])
+      continue;
+    for (int m = g ? start[g - 1] : 0; m < start[g]; m++)
+      grows[ngrows++] = (GRow){g + 1, mem[m]};
+  }
+
+  int row = -1;
+  for (int r = 0; r < ngrows && row < 0; r++) {
+    const GRow *gr = &grows[r];
+    if (gr->grp != sel_grp)
+      continue;
+    if (!sel_pid || (gr->pi >= 0 && view[gr->pi].pid == sel_pid))
+      row = r;
+  }
+  for (int r = 0; r < ngrows && row < 0; r++)
+    if (grows[r].grp == sel_grp && grows[r].pi < 0)
+      row = r;
+  view_select(row >= 0 ? row : proc_sel);
+}
+
+static void view_set_sort(int key) {
+  if (key == sort_mode)
     return;
-  if (ratio < 0.0)
-    ratio = 0.0;
-  if (ratio > 1.0)
-    ratio = 1.0;
-
-  double exact_fill = ratio * h;
-  int full_blocks = (int)exact_fill;
-  double fractional = exact_fill - full_blocks;
+  sort_mode = key;
+  view_follow_sel();
+}
 
-  attron(COLOR_PAIR(C_DIM_WHITE));
-  for (int i = 0; i < h; i++) {
-    mvaddch(y + h - 1 - i, x, ACS_CKBOARD);
-  }
-  attroff(COLOR_PAIR(C_DIM_WHITE));
+static void ui_sync(void) {
+  // The neofetch text is drawn as part of the static layout.
+  if (neofetch_poll())
+    drawn_page = -1;
+  snap = snap_latest();
+  if (!snap->tab || snap->tab_seq == ui_tab_seq)
+    return;
+  // The previous table may be recycled by the sampler from here on, so every
+  // order built on it is dropped now.
+  view = snap->tab->v;
+  view_n = snap->tab->n;
+  ui_tab_seq = snap->tab_seq;
+  for (int i = 0; i < NSORT; i++)
+    orders[i].k = -1;
+  view_follow_sel();
+}
 
-  attron(COLOR_PAIR(col) | A_BOLD);
-  for (int i = 0; i < full_blocks; i++) {
-    mvaddch(y + h - 1 - i, x, ACS_CKBOARD);
-  }
-  attroff(COLOR_PAIR(col) | A_BOLD);
+// Sleeps until a key arrives, the sampler publishes, or the terminal is
+// resized. SIGWINCH stays blocked everywhere else, so ppoll() is the only
+// place it can land and a resize between getch() and the wait is not lost.
+static volatile sig_atomic_t ui_quit = 0;
 
-  if (full_blocks < h && fractional > 0.25) {
-    attron(COLOR_PAIR(col));
-    mvaddch(y + h - 1 - full_blocks, x, ACS_CKBOARD);
-    attroff(COLOR_PAIR(col));
-  }
+static void ui_on_signal(int sig) {
+  (void)sig;
+  ui_quit = 1;
 }
 
-static int get_start_x(int width) {
-  if (COLS > width)
-    return (COLS - width) / 2;
-  return 1;
+// A hung-up terminal leaves stdin ready for good, and a ready ppoll() puts
+// the mask back without delivering the SIGHUP that came with it, so the
+// hangup itself ends the loop.
+static void ui_wait(const sigset_t *waitmask) {
+  struct pollfd pfd[2] = {{.fd = STDIN_FILENO, .events = POLLIN},
+                          {.fd = ui_evfd, .events = POLLIN}};
+  if (ppoll(pfd, 2, NULL, waitmask) <= 0)
+    return;
+  if (pfd[0].revents & (POLLHUP | POLLERR | POLLNVAL))
+    ui_quit = 1;
+  if (pfd[1].revents & POLLIN)
+    evfd_drain(ui_evfd);
 }
 
-static int get_content_width(void) {
-  if (COLS > CONTENT_WIDTH)
-    return CONTENT_WIDTH;
-  return COLS - 2;
+// Every way out of the UI goes through here, so focus reporting is never
+// left on for the shell.
+static void ui_teardown(void) {
+  putp("\033[?1004l");
+  endwin();
 }
 
-// ---------- Pages ----------
-enum {
-  PAGE_MAIN = 0,
-  PAGE_GRAPH,
-  PAGE_SYSINFO,
-  PAGE_HELP,
-  PAGE_ABOUT,
-  PAGE_PROCS,
-  PAGE_RESOURCE_MGR
-};
-static int page = PAGE_MAIN, menu_sel = 0, proc_sel = 0, sort_mode = 0;
-
 // Forward declarations
 static void draw_graphs(void);
 static void draw_sysinfo(void);
@@ -848,10 +6029,35 @@ static void draw_help(void);
 static void draw_about(void);
 static void draw_procs(void);
 static void draw_resource_mgr(void);
+static void draw_threads(void);
 
 static void draw_main(void) {
-  erase();
   int W = COLS, H = LINES;
+  bool full = ui_begin(PAGE_MAIN);
+
+  int cw = get_content_width();
+  int sx = get_start_x(cw);
+  int y = 9; // below the five info lines and the "Menu" label
+  const char *items[] = {"< Graph >",
+                         "< System Info >",
+                         "< Process Manager >",
+                         "< Resource Manager >",
+                         "< Help >",
+                         "< About >",
+                         "< Quit >"};
+  if (widget_dirty(W_MENU, sig_int(SIG_INIT, menu_sel))) {
+    for (int i = 0; i < 7; i++) {
+      if (menu_sel == i) {
+        attron(COLOR_PAIR(C_BG_GREEN) | A_BOLD);
+        mvprintw(y + i, sx, "%s", items[i]);
+        attroff(COLOR_PAIR(C_BG_GREEN) | A_BOLD);
+      } else {
+        mvprintw(y + i, sx, "%s", items[i]);
+      }
+    }
+  }
+  if (!full)
+    return;
 
   attron(COLOR_PAIR(C_HEADER) | A_BOLD);
   mvhline(0, 0, ' ', W);
@@ -860,12 +6066,10 @@ static void draw_main(void) {
   mvprintw(H - 1, 2, "↑/↓ j/k: Select  Enter: Open  q: Quit/Back");
   attroff(COLOR_PAIR(C_HEADER) | A_BOLD);
 
-  int cw = get_content_width();
-  int sx = get_start_x(cw);
   int left_col_w = cw / 3;
   int right_col_x = sx + left_col_w + 2;
   int right_col_w = cw - left_col_w - 2;
-  int y = 2;
+  y = 2;
   mvprintw(y++, sx, "CPU: %s", cpu_model);
   mvprintw(y++, sx, "Base: %.2f GHz    Cores: %d", cpu_freq_ghz, NCPU);
   mvprintw(y++, sx, "OS: %s", distro);
@@ -873,65 +6077,55 @@ static void draw_main(void) {
   mvprintw(y++, sx, "Host: %s", host);
 
   y++;
-  const char *items[] = {"< Graph >",
-                         "< System Info >",
-                         "< Process Manager >",
-                         "< Resource Manager >",
-                         "< Help >",
-                         "< About >",
-                         "< Quit >"};
   mvprintw(y++, sx, "Menu");
-  for (int i = 0; i < 7; i++) {
-    if (menu_sel == i) {
-      attron(COLOR_PAIR(C_BG_GREEN) | A_BOLD);
-      mvprintw(y + i, sx, "%s", items[i]);
-      attroff(COLOR_PAIR(C_BG_GREEN) | A_BOLD);
-    } else {
-      mvprintw(y + i, sx, "%s", items[i]);
-    }
-  }
 
-  const char *logo = pick_ascii_logo(distro);
   attron(COLOR_PAIR(C_MAGENTA) | A_BOLD);
   int ly = 2;
-  for (const char *p = logo; *p;) {
-    const char *nl = strchr(p, '\n');
-    if (!nl)
-      break;
-    mvprintw(ly++, right_col_x, "%.*s", (int)(nl - p), p);
-    p = nl + 1;
-    if (ly > H - 6)
-      break;
-  }
+  for (int i = 0; i < nlogo && ly <= H - 6; i++)
+    mvprintw(ly++, right_col_x, "%.*s", logo_line[i].len, logo_line[i].p);
   attroff(COLOR_PAIR(C_MAGENTA) | A_BOLD);
 
   ly += 1;
   attron(COLOR_PAIR(C_CYAN));
-  char *line = (char *)neofetch_info;
-  while (*line && ly < H - 2) {
-    char *end = strchr(line, '\n');
-    if (!end)
-      break;
-    int len = end - line;
+  for (int i = 0; i < nnf && ly < H - 2; i++) {
+    int len = nf_line[i].len;
     if (len > right_col_w - 4)
       len = right_col_w - 4;
-    mvprintw(ly++, right_col_x + 2, "%.*s", len, line);
-    line = end + 1;
+    mvprintw(ly++, right_col_x + 2, "%.*s", len, nf_line[i].p);
   }
   attroff(COLOR_PAIR(C_CYAN));
-  refresh();
 }
 
 static void draw_resource_mgr(void) {
   int W = COLS, H = LINES;
-  erase();
+  if (ui_begin(PAGE_RESOURCE_MGR)) {
+    attron(COLOR_PAIR(C_HEADER) | A_BOLD);
+    mvhline(0, 0, ' ', W);
+    mvprintw(0, 2, "Resource Manager");
+    mvhline(H - 1, 0, ' ', W);
+    mvprintw(H - 1, 2,
+             "D:Delete Last  T:Toggle Auto  R:Resume All  M:Match Mode  "
+             "F:Freeze  ESC/q:Back");
+    attroff(COLOR_PAIR(C_HEADER) | A_BOLD);
+  }
 
-  attron(COLOR_PAIR(C_HEADER) | A_BOLD);
-  mvhline(0, 0, ' ', W);
-  mvprintw(0, 2, "Resource Manager");
-  mvhline(H - 1, 0, ' ', W);
-  mvprintw(H - 1, 2, "D:Delete Last  T:Toggle Auto  R:Resume All  ESC/q:Back");
-  attroff(COLOR_PAIR(C_HEADER) | A_BOLD);
+  int suspended = snap->nsuspended;
+  PolEvent evs[POL_LOG];
+  pthread_mutex_lock(&mgr_lock);
+  unsigned nlog = pol_nlog;
+  memcpy(evs, pol_log, sizeof(evs));
+  pthread_mutex_unlock(&mgr_lock);
+  uint64_t sig = sig_int(SIG_INIT, auto_manage_enabled);
+  sig = sig_int(sig, nlog);
+  sig = sig_int(sig, cg_freeze);
+  sig = sig_int(sig, match_exact);
+  sig = sig_int(sig, suspended);
+  sig = sig_int(sig, num_priority_procs);
+  for (int i = 0; i < num_priority_procs; i++)
+    sig = sig_str(sig, priority_procs[i]);
+  if (!widget_dirty(W_BODY, sig))
+    return;
+  clear_rect(1, 0, H - 2, W);
 
   int cw = get_content_width();
   int sx = get_start_x(cw);
@@ -946,15 +6140,27 @@ static void draw_resource_mgr(void) {
            auto_manage_enabled ? "[ENABLED]" : "[DISABLED]");
   if (auto_manage_enabled) {
     attron(COLOR_PAIR(C_GREEN));
-    mvprintw(
-        y++, sx,
-        "System will suspend low-priority processes when priority apps run");
+    mvprintw(y++, sx,
+             "Contending processes are stepped down while priority apps run");
     attroff(COLOR_PAIR(C_GREEN));
   } else {
     attron(COLOR_PAIR(C_YELLOW));
     mvprintw(y++, sx, "Press 'T' to enable automatic resource management");
     attroff(COLOR_PAIR(C_YELLOW));
   }
+  if (cg_active)
+    mvprintw(y++, sx, "Backend: cgroup v2 (%s)",
+             cg_freeze ? "freeze background" : "throttle background");
+  else
+    mvprintw(y++, sx, "Backend: signals (SIGSTOP/SIGCONT)");
+  mvprintw(y++, sx, "Matching: %s",
+           match_exact ? "exact (critical names as prefixes)" : "substring");
+  mvprintw(y++, sx,
+           "Policy: enter >%.0f%% CPU or >%luMB for %d scans, exit <%.0f%% "
+           "and <%luMB for %d, %d/cycle",
+           pol_cfg.cpu_enter, pol_cfg.rss_enter_kb / 1024, pol_cfg.enter,
+           pol_cfg.cpu_exit, pol_cfg.rss_exit_kb / 1024, pol_cfg.exit,
+           pol_cfg.rate);
   y++;
 
   attron(COLOR_PAIR(C_CYAN) | A_BOLD);
@@ -980,39 +6186,292 @@ static void draw_resource_mgr(void) {
   mvprintw(y++, sx + 2, "1. Go to Process Manager");
   mvprintw(y++, sx + 2, "2. Select a process and press 'A' to add to priority");
   mvprintw(y++, sx + 2, "3. Enable auto management here (T)");
-  mvprintw(y++, sx + 2, "4. When priority processes run:");
-  mvprintw(y++, sx + 5, "- Suspends non-root, non-system processes");
-  mvprintw(y++, sx + 5, "- Only if using >10%% CPU or >500MB RAM");
+  mvprintw(y++, sx + 2, "4. While priority processes are busy:");
+  mvprintw(y++, sx + 5, "- Non-root processes staying over the limits are");
+  mvprintw(y++, sx + 5, "  reniced, then throttled (-c), then stopped");
+  mvprintw(y++, sx + 5, "- They step back once calm; stopped ones are held");
   mvprintw(y++, sx + 5, "- System-critical processes are protected");
-  mvprintw(y++, sx + 2, "5. Resources freed for priority processes");
+  mvprintw(y++, sx + 2, "5. Everything is released when priority goes idle");
   y++;
 
-  int suspended = 0;
-  for (int i = 0; i < nprocs; i++) {
-    if (procs[i].suspended_by_manager)
-      suspended++;
-  }
-
   if (suspended > 0) {
     attron(COLOR_PAIR(C_YELLOW) | A_BOLD);
-    mvprintw(y++, sx, "Currently Suspended: %d processes", suspended);
+    mvprintw(y++, sx, "Currently Managed: %d processes", suspended);
     attroff(COLOR_PAIR(C_YELLOW) | A_BOLD);
-    mvprintw(y++, sx + 2, "Press 'R' to resume all suspended processes");
+    mvprintw(y++, sx + 2, "Press 'R' to resume all managed processes");
+    y++;
+  }
+
+  int room = H - 2 - y - 1;
+  if (!nlog || room <= 0)
+    return;
+  attron(COLOR_PAIR(C_CYAN) | A_BOLD);
+  mvprintw(y++, sx, "Decisions (newest first):");
+  attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
+  for (unsigned i = 0; i < nlog && i < POL_LOG && (int)i < room; i++) {
+    const PolEvent *ev = &evs[(nlog - 1 - i) % POL_LOG];
+    struct tm tm;
+    char ts[16];
+    localtime_r(&ev->t, &tm);
+    strftime(ts, sizeof(ts), "%H:%M:%S", &tm);
+    attron(COLOR_PAIR(ev->to > ev->from ? C_YELLOW : C_GREEN));
+    if (ev->pid)
+      mvprintw(y++, sx + 2, "%s %-8s -> %-8s %6d %-16.16s %5.1f%% %6luMB  %s",
+               ts, pol_name[ev->from], pol_name[ev->to], (int)ev->pid,
+               ev->comm, ev->cpu, ev->rss_kb / 1024, why_name[ev->why]);
+    else
+      mvprintw(y++, sx + 2, "%s %-8s -> %-8s %6s %-32s %s", ts,
+               pol_name[ev->from], pol_name[ev->to], "-", ev->comm,
+               why_name[ev->why]);
+    attroff(COLOR_PAIR(ev->to > ev->from ? C_YELLOW : C_GREEN));
+  }
+}
+
+static void draw_freq_box(int y, int start_x, int box_h, int max_w, int bar_h,
+                          const double *freqs, bool any_freq) {
+  double fmax = cpu_freq_ghz * 1000.0;
+  if (fmax < 1000)
+    fmax = 4000.0;
+
+  clear_rect(y, start_x, box_h, max_w);
+  draw_box(y, start_x, box_h, max_w);
+  attron(COLOR_PAIR(C_CYAN) | A_BOLD);
+  mvprintw(y, start_x + 2, " Frequency [MHz] ");
+  attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
+
+  int bar_width = 3, bar_spacing = 4;
+  if (any_freq) {
+    for (int i = 0; i < NCPU && i < MAX_CORES; i++) {
+      int x = start_x + 4 + (i * (bar_width + bar_spacing));
+      if (x + bar_width + 2 > max_w + start_x)
+        break;
+      double f_ratio = freqs[i] / fmax;
+      draw_vert_bar(y + 2, x, bar_h, f_ratio, get_color(f_ratio));
+      mvprintw(y + bar_h + 2, x, "%4.0f", freqs[i]);
+      char clbl[8];
+      snprintf(clbl, sizeof(clbl), "Core %d", i);
+      mvprintw(y + 1, x, "%-6.6s", clbl);
+    }
+  } else {
+    mvprintw(y + bar_h / 2 + 1, start_x + max_w / 2 - 10,
+             "Frequency data unavailable");
+  }
+}
+
+static int hist_level = HL_RAW;
+
+static void fmt_span(char *out, size_t n, uint32_t secs) {
+  if (secs < 120)
+    snprintf(out, n, "%us", secs);
+  else if (secs < 7200)
+    snprintf(out, n, "%um", secs / 60);
+  else if (secs < 172800)
+    snprintf(out, n, "%uh", secs / 3600);
+  else
+    snprintf(out, n, "%ud", secs / 86400);
+}
+
+// CPU as bars, memory as a '*' trace, newest entry in the rightmost column.
+static void draw_history_box(int y, int x, int h, int w) {
+  int cols = w - 4, rows = h - 3;
+  uint64_t sig = sig_int(SIG_INIT, hist_level);
+  sig = sig_int(sig, hist_head(hist_level));
+  sig = sig_int(sig, hist_get(hist_level, 0) != 0);
+  if (cols < 1 || rows < 1 || !widget_dirty(W_BOX3, sig))
+    return;
+
+  clear_rect(y, x, h, w);
+  draw_box(y, x, h, w);
+  attron(COLOR_PAIR(C_CYAN) | A_BOLD);
+  mvprintw(y, x + 2, " History [%s] CPU | Mem * ", hl_name[hist_level]);
+  attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
+  if (hist_path)
+    mvprintw(y, x + w - 12, " persisted ");
+
+  int base = y + rows; // bottom chart row
+  uint32_t t_new = 0, t_old = 0;
+  for (int c = 0; c < cols; c++) {
+    uint64_t e = hist_get(hist_level, (uint32_t)(cols - 1 - c));
+    if (!e)
+      continue;
+    uint32_t t = (uint32_t)(e >> 32);
+    if (!t_old)
+      t_old = t;
+    t_new = t;
+    double cr = (e >> 16 & 0xffff) / 10000.0, mr = (e & 0xffff) / 10000.0;
+    int ch = (int)lround(cr * rows), mh = (int)lround(mr * (rows - 1));
+    int col = get_color(cr);
+    attron(COLOR_PAIR(col));
+    for (int r = 0; r < ch; r++)
+      mvaddch(base - r, x + 2 + c, ACS_CKBOARD);
+    attroff(COLOR_PAIR(col));
+    attron(COLOR_PAIR(C_MAGENTA) | A_BOLD);
+    mvaddch(base - mh, x + 2 + c, '*');
+    attroff(COLOR_PAIR(C_MAGENTA) | A_BOLD);
+  }
+
+  if (!t_new) {
+    mvprintw(y + h / 2, x + w / 2 - 8, "No history yet");
+    return;
+  }
+  char span[16];
+  fmt_span(span, sizeof(span), t_new - t_old);
+  mvprintw(y + h - 2, x + 2, "-%s", span);
+  mvprintw(y + h - 2, x + w - 6, "now");
+}
+
+// The bottom box of the graphs page, cycled with 'c'.
+enum { GV_HISTORY, GV_CORES, GV_BREAKDOWN, NGV };
+static int graph_view = GV_HISTORY;
+
+// Per-core usage over the last HIST_W ticks: the bar is the window average
+// with markers for the minimum, 95th percentile and maximum.
+static void draw_cores_box(int y, int x, int h, int w) {
+  const CoreHist *ch = &snap->hist;
+  int nc = ch->ncores, rows = h - 3;
+  uint64_t sig = sig_bytes(SIG_INIT, ch->core, (size_t)nc * sizeof(CoreStat));
+  sig = sig_int(sig, ch->all_avg);
+  sig = sig_int(sig, ch->all_peak);
+  if (rows < 1 || !widget_dirty(W_BOX3, sig))
+    return;
+
+  clear_rect(y, x, h, w);
+  draw_box(y, x, h, w);
+  attron(COLOR_PAIR(C_CYAN) | A_BOLD);
+  mvprintw(y, x + 2, " Cores [%ds] avg | . min  = p95  ^ max ",
+           HIST_W * CPU_MS / 1000);
+  attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
+  if (nc <= 0 || ch->nsamp <= 0) {
+    mvprintw(y + h / 2, x + w / 2 - 8, "No history yet");
+    return;
+  }
+  mvprintw(y + h - 2, x + 2, "all cores: avg %.1f%%  peak %.1f%%",
+           ch->all_avg * 100.0 / HIST_SCALE,
+           ch->all_peak * 100.0 / HIST_SCALE);
+
+  int base = y + rows, fit = (w - 4) / 2;
+  for (int c = 0; c < nc && c < fit; c++) {
+    const CoreStat *cs = &ch->core[c];
+    int cx = x + 2 + c * 2;
+    double avg = (double)cs->avg / HIST_SCALE;
+    int ah = (int)lround(avg * rows);
+    attron(COLOR_PAIR(get_color(avg)));
+    for (int r = 0; r < ah; r++)
+      mvaddch(base - r, cx, ACS_CKBOARD);
+    attroff(COLOR_PAIR(get_color(avg)));
+    int top = rows - 1;
+    attron(A_BOLD);
+    mvaddch(base - (int)lround((double)cs->min / HIST_SCALE * top), cx, '.');
+    mvaddch(base - (int)lround((double)cs->p95 / HIST_SCALE * top), cx, '=');
+    mvaddch(base - (int)lround((double)cs->max / HIST_SCALE * top), cx, '^');
+    attroff(A_BOLD);
+  }
+  if (nc > fit)
+    mvprintw(y + h - 2, x + w - 14, "+%d cores", nc - fit);
+}
+
+static const int cat_color[NCAT] = {C_GREEN, C_BLUE, C_YELLOW, C_RED};
+static const char *cat_name[NCAT] = {"user", "sys", "iowait", "steal"};
+
+// One column of a stacked bar, categories bottom to top, rounded on the
+// running sum so the segments add up to the column height.
+static void draw_stack(int base, int x, int rows, const uint16_t *cat) {
+  int h0 = 0;
+  uint32_t sum = 0;
+  for (int k = 0; k < NCAT; k++) {
+    sum += cat[k];
+    int h1 = (int)lround((double)sum / HIST_SCALE * rows);
+    if (h1 > rows)
+      h1 = rows;
+    attron(COLOR_PAIR(cat_color[k]));
+    for (int r = h0; r < h1; r++)
+      mvaddch(base - r, x, ACS_CKBOARD);
+    attroff(COLOR_PAIR(cat_color[k]));
+    if (h1 > h0)
+      h0 = h1;
+  }
+}
+
+// Per-core categories of the last tick on the left, the aggregate over the
+// last HIST_W ticks on the right with the newest tick in the last column.
+static void draw_breakdown_box(int y, int x, int h, int w) {
+  const CpuSnap *cs = &snap->cpu;
+  const CoreHist *ch = &snap->hist;
+  int nc = cs->ncores < MAX_CORES ? cs->ncores : MAX_CORES, rows = h - 3;
+  uint64_t sig = sig_bytes(SIG_INIT, cs->cat, (size_t)(nc + 1) * NCAT * 2);
+  sig = sig_bytes(sig, ch->cat, (size_t)ch->nsamp * NCAT * 2);
+  if (rows < 1 || !widget_dirty(W_BOX3, sig))
+    return;
+
+  clear_rect(y, x, h, w);
+  draw_box(y, x, h, w);
+  attron(COLOR_PAIR(C_CYAN) | A_BOLD);
+  mvprintw(y, x + 2, " CPU breakdown ");
+  attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
+  for (int k = 0; k < NCAT; k++) {
+    attron(COLOR_PAIR(cat_color[k]) | A_BOLD);
+    printw("%s ", cat_name[k]);
+    attroff(COLOR_PAIR(cat_color[k]) | A_BOLD);
   }
+  int lx = x + 2;
+  mvprintw(y + h - 2, lx, "now");
+  for (int k = 0; k < NCAT; k++) {
+    attron(COLOR_PAIR(cat_color[k]));
+    printw("  %s %.1f%%", cat_name[k], cs->cat[0][k] * 100.0 / HIST_SCALE);
+    attroff(COLOR_PAIR(cat_color[k]));
+  }
+
+  int base = y + rows, cw = w - 4;
+  int fit = nc * 2 <= cw / 3 ? nc : cw / 6;
+  for (int c = 0; c < fit; c++)
+    draw_stack(base, lx + c * 2, rows, cs->cat[c + 1]);
+  int tx = lx + fit * 2 + 2, tw = x + w - 2 - tx;
+  if (fit > 0)
+    mvvline(y + 1, tx - 2, ACS_VLINE, rows);
+  for (int c = 0; c < tw && c < ch->nsamp; c++)
+    draw_stack(base, tx + tw - 1 - c, rows, ch->cat[ch->nsamp - 1 - c]);
+}
 
-  refresh();
+// One line of PSI averages above the boxes; some/full over the last 10s.
+static void draw_pressure_line(int y, int x) {
+  const PsiSnap *ps = &snap->psi;
+  uint64_t sig = sig_bytes(SIG_INIT, ps->res, sizeof(ps->res));
+  if (!widget_dirty(W_TITLE, sig_int(sig, ps->ok)))
+    return;
+  move(y, 0);
+  clrtoeol();
+  attron(A_BOLD);
+  mvprintw(y, x, "Pressure avg10");
+  attroff(A_BOLD);
+  if (!ps->ok) {
+    printw("  n/a");
+    return;
+  }
+  for (int r = 0; r < NPSI; r++) {
+    const PsiRes *pr = &ps->res[r];
+    uint16_t worst = pr->some10 > pr->full10 ? pr->some10 : pr->full10;
+    int col = worst >= 2000 ? C_RED : worst >= 500 ? C_YELLOW : C_GREEN;
+    printw("   %s ", psi_name[r]);
+    attron(COLOR_PAIR(col));
+    printw("some %.2f%%", pr->some10 / 100.0);
+    if (r != PSI_CPU || pr->full10)
+      printw(" full %.2f%%", pr->full10 / 100.0);
+    attroff(COLOR_PAIR(col));
+  }
 }
 
 static void draw_graphs(void) {
   int W = COLS, H = LINES;
-  erase();
-
-  attron(COLOR_PAIR(C_HEADER) | A_BOLD);
-  mvhline(0, 0, ' ', W);
-  mvprintw(0, 2, "System Monitor (Graphs)");
-  mvhline(H - 1, 0, ' ', W);
-  mvprintw(H - 1, 2, "ESC/q: back");
-  attroff(COLOR_PAIR(C_HEADER) | A_BOLD);
+  if (ui_begin(PAGE_GRAPH)) {
+    attron(COLOR_PAIR(C_HEADER) | A_BOLD);
+    mvhline(0, 0, ' ', W);
+    mvprintw(0, 2, "System Monitor (Graphs)");
+    mvhline(H - 1, 0, ' ', W);
+    mvprintw(H - 1, 2,
+             "h/H: history resolution  c: history/cores/breakdown  "
+             "ESC/q: back");
+    attroff(COLOR_PAIR(C_HEADER) | A_BOLD);
+  }
 
   int start_y = 2;
   int bar_h = 7;
@@ -1029,102 +6488,117 @@ static void draw_graphs(void) {
 
   int y = start_y;
   int half_w = (max_w - 3) / 2;
-
-  draw_box(y, start_x, box_h, half_w);
-  attron(COLOR_PAIR(C_CYAN) | A_BOLD);
-  mvprintw(y, start_x + 2, " Temp [C] ");
-  attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
-
-  if (temp_available) {
-    double tc = temp_c();
-    double t_ratio = tc / 100.0;
-    if (t_ratio < 0)
-      t_ratio = 0;
-    if (t_ratio > 1)
-      t_ratio = 1;
-
-    draw_vert_bar(y + 2, start_x + 4, bar_h, t_ratio, get_color(t_ratio));
-    mvprintw(y + bar_h + 2, start_x + 3, "%.1f", tc);
-    char tlabel[32];
-    snprintf(tlabel, sizeof(tlabel), "%s",
-             tz_path[0] ? (strrchr(tz_path, '/') ? strrchr(tz_path, '/') + 1
-                                                 : "Sensor")
-                        : "N/A");
-    mvprintw(y + 1, start_x + 3, "%-6.6s", tlabel);
-  } else {
-    mvprintw(y + bar_h / 2 + 1, start_x + 3, "N/A");
+  draw_pressure_line(y - 1, start_x);
+
+  double tc = snap->sens.temp_c;
+  if (widget_dirty(W_BOX0, sig_int(SIG_INIT, llround(tc * 10)))) {
+    clear_rect(y, start_x, box_h, half_w);
+    draw_box(y, start_x, box_h, half_w);
+    attron(COLOR_PAIR(C_CYAN) | A_BOLD);
+    mvprintw(y, start_x + 2, " Temp [C] ");
+    attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
+
+    if (snap->sens.temp_ok) {
+      double t_ratio = tc / 100.0;
+      if (t_ratio < 0)
+        t_ratio = 0;
+      if (t_ratio > 1)
+        t_ratio = 1;
+
+      draw_vert_bar(y + 2, start_x + 4, bar_h, t_ratio, get_color(t_ratio));
+      mvprintw(y + bar_h + 2, start_x + 3, "%.1f", tc);
+      char tlabel[32];
+      snprintf(tlabel, sizeof(tlabel), "%s",
+               tz_path[0] ? (strrchr(tz_path, '/') ? strrchr(tz_path, '/') + 1
+                                                   : "Sensor")
+                          : "N/A");
+      mvprintw(y + 1, start_x + 3, "%-6.6s", tlabel);
+    } else {
+      mvprintw(y + bar_h / 2 + 1, start_x + 3, "N/A");
+    }
   }
 
   int mem_x = start_x + half_w + 3;
-  draw_box(y, mem_x, box_h, half_w);
-  attron(COLOR_PAIR(C_CYAN) | A_BOLD);
-  mvprintw(y, mem_x + 2, " Memory [%%] ");
-  attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
-
-  unsigned long mt = 0, mf = 0, ma = 0;
-  mem_read_kb(&mt, &mf, &ma);
+  unsigned long mt = snap->mem.total_kb, ma = snap->mem.avail_kb;
   double mem_used_pct = mt ? (double)(mt - ma) / mt : 0.0;
 
-  draw_vert_bar(y + 2, mem_x + 4, bar_h, mem_used_pct, get_color(mem_used_pct));
-  mvprintw(y + bar_h + 2, mem_x + 3, "%.1f%%", mem_used_pct * 100.0);
-  mvprintw(y + 1, mem_x + 3, "Used");
-  mvprintw(y + 1, mem_x + 12, "%.0fMB/%.0fMB", (mt - ma) / 1024.0, mt / 1024.0);
+  uint64_t msig = sig_int(SIG_INIT, llround(mem_used_pct * 1000));
+  msig = sig_int(msig, (long long)((mt - ma) / 1024));
+  msig = sig_int(msig, (long long)(mt / 1024));
+  if (widget_dirty(W_BOX1, msig)) {
+    clear_rect(y, mem_x, box_h, half_w);
+    draw_box(y, mem_x, box_h, half_w);
+    attron(COLOR_PAIR(C_CYAN) | A_BOLD);
+    mvprintw(y, mem_x + 2, " Memory [%%] ");
+    attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
+
+    draw_vert_bar(y + 2, mem_x + 4, bar_h, mem_used_pct,
+                  get_color(mem_used_pct));
+    mvprintw(y + bar_h + 2, mem_x + 3, "%.1f%%", mem_used_pct * 100.0);
+    mvprintw(y + 1, mem_x + 3, "Used");
+    mvprintw(y + 1, mem_x + 12, "%.0fMB/%.0fMB", (mt - ma) / 1024.0,
+             mt / 1024.0);
+  }
 
   y += box_h + 1;
   if (y > H - 10)
-    goto end_draw;
-
-  draw_box(y, start_x, box_h, max_w);
-  attron(COLOR_PAIR(C_CYAN) | A_BOLD);
-  mvprintw(y, start_x + 2, " Frequency [MHz] ");
-  attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
-
-  double freqs[MAX_CORES] = {0};
-  read_cpu_freq_mhz(freqs);
-  double fmax = cpu_freq_ghz * 1000.0;
-  if (fmax < 1000)
-    fmax = 4000.0;
+    return;
 
-  int bar_width = 3, bar_spacing = 4;
+  const double *freqs = snap->sens.freq_mhz;
+  uint64_t fsig = SIG_INIT;
   bool any_freq = false;
   for (int i = 0; i < NCPU && i < MAX_CORES; i++) {
-    if (freqs[i] > 0) {
+    if (freqs[i] > 0)
       any_freq = true;
-      break;
-    }
-  }
-
-  if (any_freq) {
-    for (int i = 0; i < NCPU && i < MAX_CORES; i++) {
-      int x = start_x + 4 + (i * (bar_width + bar_spacing));
-      if (x + bar_width + 2 > max_w + start_x)
-        break;
-      double f_ratio = freqs[i] / fmax;
-      draw_vert_bar(y + 2, x, bar_h, f_ratio, get_color(f_ratio));
-      mvprintw(y + bar_h + 2, x, "%4.0f", freqs[i]);
-      char clbl[8];
-      snprintf(clbl, sizeof(clbl), "Core %d", i);
-      mvprintw(y + 1, x, "%-6.6s", clbl);
-    }
-  } else {
-    mvprintw(y + bar_h / 2 + 1, start_x + max_w / 2 - 10,
-             "Frequency data unavailable");
+    fsig = sig_int(fsig, llround(freqs[i]));
   }
+  if (widget_dirty(W_BOX2, fsig))
+    draw_freq_box(y, start_x, box_h, max_w, bar_h, freqs, any_freq);
 
-end_draw:
-  refresh();
+  y += box_h + 1;
+  if (H - 1 - y < 6)
+    return;
+  if (graph_view == GV_CORES)
+    draw_cores_box(y, start_x, H - 1 - y, max_w);
+  else if (graph_view == GV_BREAKDOWN)
+    draw_breakdown_box(y, start_x, H - 1 - y, max_w);
+  else
+    draw_history_box(y, start_x, H - 1 - y, max_w);
 }
 
 static void draw_sysinfo(void) {
   int W = COLS, H = LINES;
-  erase();
+  if (ui_begin(PAGE_SYSINFO)) {
+    attron(COLOR_PAIR(C_HEADER) | A_BOLD);
+    mvhline(0, 0, ' ', W);
+    mvprintw(0, 2, "System Information");
+    if (nremote_addrs)
+      printw(" (local machine)");
+    mvhline(H - 1, 0, ' ', W);
+    mvprintw(H - 1, 2, "Press ESC or q to return");
+    attroff(COLOR_PAIR(C_HEADER) | A_BOLD);
+  }
 
-  attron(COLOR_PAIR(C_HEADER) | A_BOLD);
-  mvhline(0, 0, ' ', W);
-  mvprintw(0, 2, "System Information");
-  mvhline(H - 1, 0, ' ', W);
-  mvprintw(H - 1, 2, "Press ESC or q to return");
-  attroff(COLOR_PAIR(C_HEADER) | A_BOLD);
+  const SysDyn *sd = &snap->sysd;
+  double avg_freq = snap->sens.freq_avg;
+  double tc = snap->sens.temp_c;
+  long up = sd->uptime_s;
+
+  // gen moves whenever storage, network and battery were re-read.
+  uint64_t sig = sig_int(SIG_INIT, llround(avg_freq));
+  sig = sig_int(sig, llround(tc * 10));
+  sig = sig_int(sig, llround(snap->cpu.total * 1000));
+  sig = sig_int(sig, (long long)(snap->mem.total_kb / 1024));
+  sig = sig_int(sig, (long long)(snap->mem.free_kb / 1024));
+  sig = sig_int(sig, (long long)(snap->mem.avail_kb / 1024));
+  sig = sig_int(sig, (long long)(snap->mem.buffers_kb / 1024));
+  sig = sig_int(sig, (long long)(snap->mem.cached_kb / 1024));
+  sig = sig_int(sig, (long long)(snap->mem.swap_free_kb / 1024));
+  sig = sig_int(sig, up);
+  sig = sig_int(sig, sd->gen);
+  if (!widget_dirty(W_BODY, sig))
+    return;
+  clear_rect(1, 0, H - 2, W);
 
   int cw = get_content_width();
   int sx = get_start_x(cw);
@@ -1140,35 +6614,21 @@ static void draw_sysinfo(void) {
     mvprintw(y++, sx, "Base Frequency: %.2f GHz", cpu_freq_ghz);
   }
 
-  double freqs[MAX_CORES] = {0};
-  read_cpu_freq_mhz(freqs);
-  double avg_freq = 0;
-  int freq_count = 0;
-  for (int i = 0; i < NCPU && i < MAX_CORES; i++) {
-    if (freqs[i] > 0) {
-      avg_freq += freqs[i];
-      freq_count++;
-    }
-  }
-  if (freq_count > 0) {
-    avg_freq /= freq_count;
+  if (avg_freq > 0)
     mvprintw(y++, sx, "Current Frequency: %.0f MHz (avg)", avg_freq);
-  }
 
-  if (temp_available) {
-    double tc = temp_c();
+  if (snap->sens.temp_ok)
     mvprintw(y++, sx, "Temperature: %.1f°C", tc);
-  }
 
-  mvprintw(y++, sx, "Current Usage: %.1f%%", cpu.total * 100.0);
+  mvprintw(y++, sx, "Current Usage: %.1f%%", snap->cpu.total * 100.0);
   y++;
 
   attron(COLOR_PAIR(C_CYAN) | A_BOLD);
   mvprintw(y++, sx, "======== MEMORY ========");
   attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
 
-  unsigned long mt = 0, mf = 0, ma = 0;
-  mem_read_kb(&mt, &mf, &ma);
+  unsigned long mt = snap->mem.total_kb, mf = snap->mem.free_kb,
+                ma = snap->mem.avail_kb;
   double mem_used_mb = (mt - ma) / 1024.0;
   double mem_avail_mb = ma / 1024.0;
   double mem_free_mb = mf / 1024.0;
@@ -1180,25 +6640,26 @@ static void draw_sysinfo(void) {
   mvprintw(y++, sx, "Used: %.0f MB (%.1f%%)", mem_used_mb, used_pct);
   mvprintw(y++, sx, "Available: %.0f MB", mem_avail_mb);
   mvprintw(y++, sx, "Free: %.0f MB", mem_free_mb);
+  mvprintw(y++, sx, "Buffers: %.0f MB    Cached: %.0f MB",
+           snap->mem.buffers_kb / 1024.0, snap->mem.cached_kb / 1024.0);
+  unsigned long st = snap->mem.swap_total_kb, sf = snap->mem.swap_free_kb;
+  if (st)
+    mvprintw(y++, sx, "Swap: %.0f MB / %.0f MB (%.1f%%)", (st - sf) / 1024.0,
+             st / 1024.0, (double)(st - sf) * 100.0 / st);
+  else
+    mvprintw(y++, sx, "Swap: none");
   y++;
 
   attron(COLOR_PAIR(C_CYAN) | A_BOLD);
   mvprintw(y++, sx, "======== STORAGE ========");
   attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
 
-  FILE *df = popen("df -h / 2>/dev/null | tail -1", "r");
-  if (df) {
-    char fs[64], size[32], used[32], avail[32], use_pct[32], mount[64];
-    if (fscanf(df, "%63s %31s %31s %31s %31s %63s", fs, size, used, avail,
-               use_pct, mount) == 6) {
-      mvprintw(y++, sx, "Root Filesystem: %s", fs);
-      mvprintw(y++, sx, "Total: %s", size);
-      mvprintw(y++, sx, "Used: %s (%s)", used, use_pct);
-      mvprintw(y++, sx, "Available: %s", avail);
-    } else {
-      mvprintw(y++, sx, "Storage info unavailable");
-    }
-    pclose(df);
+  if (sd->fs_ok) {
+    const double gib = 1024.0 * 1024.0 * 1024.0;
+    mvprintw(y++, sx, "Root Filesystem: %s", root_dev[0] ? root_dev : "/");
+    mvprintw(y++, sx, "Total: %.1fG", sd->fs_total / gib);
+    mvprintw(y++, sx, "Used: %.1fG (%d%%)", sd->fs_used / gib, sd->fs_pct);
+    mvprintw(y++, sx, "Available: %.1fG", sd->fs_avail / gib);
   } else {
     mvprintw(y++, sx, "Storage info unavailable");
   }
@@ -1212,111 +6673,55 @@ static void draw_sysinfo(void) {
   mvprintw(y++, sx, "Kernel: %s", kernel_rel);
   mvprintw(y++, sx, "Hostname: %s", host);
 
-  int uh, um, us;
-  read_uptime(&uh, &um, &us);
-  mvprintw(y++, sx, "Uptime: %dd %02dh %02dm %02ds", uh / 24, uh % 24, um, us);
+  mvprintw(y++, sx, "Uptime: %ldd %02ldh %02ldm %02lds", up / 86400,
+           up / 3600 % 24, up / 60 % 60, up % 60);
   y++;
 
   attron(COLOR_PAIR(C_CYAN) | A_BOLD);
   mvprintw(y++, sx, "======== NETWORK ========");
   attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
 
-  FILE *ip_cmd =
-      popen("ip -4 addr show 2>/dev/null | grep -oP "
-            "'(?<=inet\\s)\\d+(\\.\\d+){3}' | grep -v 127.0.0.1 | head -1",
-            "r");
-  char local_ip[64] = "Not connected";
-  if (ip_cmd) {
-    if (fgets(local_ip, sizeof(local_ip), ip_cmd)) {
-      local_ip[strcspn(local_ip, "\n")] = 0;
-    }
-    pclose(ip_cmd);
-  }
-  mvprintw(y++, sx, "Local IP: %s", local_ip);
-
-  FILE *iface_cmd =
-      popen("ip route | grep default | awk '{print $5}' | head -1", "r");
-  char iface[64] = "Unknown";
-  if (iface_cmd) {
-    if (fgets(iface, sizeof(iface), iface_cmd)) {
-      iface[strcspn(iface, "\n")] = 0;
-    }
-    pclose(iface_cmd);
-  }
-  mvprintw(y++, sx, "Interface: %s", iface);
-
-  FILE *gw_cmd =
-      popen("ip route | grep default | awk '{print $3}' | head -1", "r");
-  char gateway[64] = "Unknown";
-  if (gw_cmd) {
-    if (fgets(gateway, sizeof(gateway), gw_cmd)) {
-      gateway[strcspn(gateway, "\n")] = 0;
-    }
-    pclose(gw_cmd);
-  }
-  mvprintw(y++, sx, "Gateway: %s", gateway);
+  mvprintw(y++, sx, "Local IP: %s", sd->ip);
+  mvprintw(y++, sx, "Interface: %s", sd->iface);
+  mvprintw(y++, sx, "Gateway: %s", sd->gw);
   y++;
 
-  attron(COLOR_PAIR(C_CYAN) | A_BOLD);
-  mvprintw(y++, sx, "======== BATTERY ========");
-  attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
-
-  FILE *bat_cap = fopen("/sys/class/power_supply/BAT0/capacity", "r");
-  FILE *bat_stat = fopen("/sys/class/power_supply/BAT0/status", "r");
-  FILE *bat_health = fopen("/sys/class/power_supply/BAT0/health", "r");
-
-  if (bat_cap && bat_stat) {
-    int capacity = 0;
-    char status[32] = "Unknown";
-    char health[32] = "Unknown";
-
-    fscanf(bat_cap, "%d", &capacity);
-    if (fgets(status, sizeof(status), bat_stat)) {
-      status[strcspn(status, "\n")] = 0;
-    }
-    if (bat_health && fgets(health, sizeof(health), bat_health)) {
-      health[strcspn(health, "\n")] = 0;
-    }
-
-    int bat_color = C_GREEN;
-    if (capacity < 20)
-      bat_color = C_RED;
-    else if (capacity < 50)
-      bat_color = C_YELLOW;
-
-    attron(COLOR_PAIR(bat_color));
-    mvprintw(y++, sx, "Percentage: %d%%", capacity);
-    attroff(COLOR_PAIR(bat_color));
-
-    mvprintw(y++, sx, "Status: %s", status);
-    mvprintw(y++, sx, "Health: %s", health);
-
-    int barw = (cw > 60) ? 40 : (cw - 20);
-    int filled = (capacity * barw) / 100;
-
-    attron(COLOR_PAIR(bat_color) | A_BOLD);
-    mvhline(y, sx + 2, ACS_CKBOARD, filled);
-    attroff(COLOR_PAIR(bat_color) | A_BOLD);
-    attron(COLOR_PAIR(C_DIM_WHITE));
-    mvhline(y, sx + 2 + filled, ACS_CKBOARD, barw - filled);
-    attroff(COLOR_PAIR(C_DIM_WHITE));
+  attron(COLOR_PAIR(C_CYAN) | A_BOLD);
+  mvprintw(y++, sx, "======== BATTERY ========");
+  attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
 
-  } else {
+  if (!sd->bat_ok) {
     mvprintw(y++, sx, "No battery detected");
+    return;
   }
-
-  if (bat_cap)
-    fclose(bat_cap);
-  if (bat_stat)
-    fclose(bat_stat);
-  if (bat_health)
-    fclose(bat_health);
-
-  refresh();
+  int capacity = sd->bat_cap;
+  int bat_color = C_GREEN;
+  if (capacity < 20)
+    bat_color = C_RED;
+  else if (capacity < 50)
+    bat_color = C_YELLOW;
+
+  attron(COLOR_PAIR(bat_color));
+  mvprintw(y++, sx, "Percentage: %d%%", capacity);
+  attroff(COLOR_PAIR(bat_color));
+
+  mvprintw(y++, sx, "Status: %s", sd->bat_status);
+  mvprintw(y++, sx, "Health: %s", sd->bat_health);
+
+  int barw = (cw > 60) ? 40 : (cw - 20);
+  int filled = (capacity * barw) / 100;
+
+  attron(COLOR_PAIR(bat_color) | A_BOLD);
+  mvhline(y, sx + 2, ACS_CKBOARD, filled);
+  attroff(COLOR_PAIR(bat_color) | A_BOLD);
+  attron(COLOR_PAIR(C_DIM_WHITE));
+  mvhline(y, sx + 2 + filled, ACS_CKBOARD, barw - filled);
+  attroff(COLOR_PAIR(C_DIM_WHITE));
 }
 
 static void draw_help(void) {
-  erase();
+  if (!ui_begin(PAGE_HELP))
+    return;
   int W = COLS, H = LINES;
   attron(COLOR_PAIR(C_HEADER) | A_BOLD);
   mvhline(0, 0, ' ', W);
@@ -1331,18 +6736,26 @@ static void draw_help(void) {
   mvprintw(y++, sx + 4, "↑/↓ or j/k  - Move selection");
   mvprintw(y++, sx + 4, "Enter        - Select");
   mvprintw(y++, sx + 4, "ESC or q     - Back/Quit");
+  mvprintw(y++, sx + 4, "P            - Toggle self-profile overlay");
+  mvprintw(y++, sx + 4, "[ / ]        - Scan faster/slower  = - adaptive");
+  mvprintw(y++, sx + 4, "Tab          - Next daemon (-C, view only)");
   y++;
   mvprintw(y++, sx, "Process Manager:");
   mvprintw(y++, sx + 4, "c            - Sort by CPU    m  - Sort by Memory");
+  mvprintw(y++, sx + 4, "p            - Sort by PID    n  - Sort by Name");
+  mvprintw(y++, sx + 4, "u            - Sort by User");
+  mvprintw(y++, sx + 4, "e            - I/O, switch and thread columns");
+  mvprintw(y++, sx + 4, "i / w / t    - Sort by I/O, Switches, Threads");
   mvprintw(y++, sx + 4, "K            - Kill process   S  - Stop/Continue");
   mvprintw(y++, sx + 4, "+ / -        - Increase/Decrease priority (nice)");
   mvprintw(y++, sx + 4, "A            - Add to priority list");
-  refresh();
+  mvprintw(y++, sx + 4, "Enter        - Threads of the selected process");
+  mvprintw(y++, sx + 4, "g            - Group by cgroup; Enter opens a group");
 }
 
 static void draw_about(void) {
-  run_neofetch_stdout();
-  erase();
+  if (!ui_begin(PAGE_ABOUT))
+    return;
   int W = COLS, H = LINES;
   attron(COLOR_PAIR(C_HEADER) | A_BOLD);
   mvhline(0, 0, ' ', W);
@@ -1357,18 +6770,9 @@ static void draw_about(void) {
   int info_x = sx + logo_w;
   int info_w = cw - logo_w;
 
-  const char *logo = pick_ascii_logo(distro);
   attron(COLOR_PAIR(C_MAGENTA) | A_BOLD);
-  int ly = 2;
-  for (const char *p = logo; *p;) {
-    const char *nl = strchr(p, '\n');
-    if (!nl)
-      break;
-    mvprintw(ly++, sx, "%.*s", (int)(nl - p), p);
-    p = nl + 1;
-    if (ly > H - 6)
-      break;
-  }
+  for (int i = 0, ly = 2; i < nlogo && ly <= H - 6; i++)
+    mvprintw(ly++, sx, "%.*s", logo_line[i].len, logo_line[i].p);
   attroff(COLOR_PAIR(C_MAGENTA) | A_BOLD);
 
   attron(COLOR_PAIR(C_WHITE) | A_BOLD);
@@ -1380,30 +6784,23 @@ static void draw_about(void) {
 
   int ny = 7;
   attron(COLOR_PAIR(C_CYAN));
-  char *line = (char *)neofetch_info;
-  while (*line && ny < H - 2) {
-    char *end = strchr(line, '\n');
-    if (!end)
-      break;
-    int len = end - line;
+  for (int i = 0; i < nnf && ny < H - 2; i++) {
+    int len = nf_line[i].len;
     if (len > info_w - 2)
       len = info_w - 2;
-    mvprintw(ny++, info_x, "%.*s", len, line);
-    line = end + 1;
+    mvprintw(ny++, info_x, "%.*s", len, nf_line[i].p);
   }
   attroff(COLOR_PAIR(C_CYAN));
-  refresh();
 }
 
 static void draw_procs(void) {
   int W = COLS, H = LINES;
 
+  bool full = ui_begin(PAGE_PROCS);
   if (W < 40 || H < 10) {
     return;
   }
 
-  erase();
-
   int cw = get_content_width();
   int sx = get_start_x(cw);
 
@@ -1414,16 +6811,56 @@ static void draw_procs(void) {
   if (cw < 60)
     cw = 60;
 
-  attron(COLOR_PAIR(C_HEADER) | A_BOLD);
-  mvhline(0, 0, ' ', W);
-  mvprintw(0, 2, "Process Manager - %d processes", nprocs);
-  mvhline(H - 1, 0, ' ', W);
-  mvprintw(
-      H - 1, 2,
-      "↑↓:Move c:CPU m:Mem A:Add Priority K:Kill S:Stop/Cont +/-:Nice q:Back");
-  attroff(COLOR_PAIR(C_HEADER) | A_BOLD);
+  bool ext = atomic_load(&ext_cols);
+  if (grouped && grows_stale)
+    grows_build();
+  int nrows = list_n();
+  if (full) {
+    attron(COLOR_PAIR(C_HEADER) | A_BOLD);
+    mvhline(H - 1, 0, ' ', W);
+    mvprintw(H - 1, 2,
+             "↑↓:Move c:CPU m:Mem A:Add Priority K:Kill S:Stop/Cont "
+             "+/-:Nice e:Counters g:Groups Enter:Open q:Back");
+    char header_fmt[128];
+    snprintf(header_fmt, sizeof(header_fmt), "%%-%ds", cw);
+    const char *cols =
+        ext ? " PID    COMMAND              USER         CPU%%      MEM(MB)"
+              "   NI STATE  THR   READ/s  WRITE/s   CSW/s PRI"
+            : " PID    COMMAND              USER         CPU%%      MEM(MB)"
+              "   NI STATE  PRI";
+    mvprintw(5, sx, header_fmt, cols);
+    attroff(A_BOLD | COLOR_PAIR(C_HEADER));
+  }
 
-  mvprintw(2, sx, "CPU:");
+  const ChurnStats *ch = &snap->churn;
+  bool fixed = atomic_load(&cad_fixed) != 0;
+  int ngroups = 0;
+  for (int r = 0; grouped && r < ngrows; r++)
+    ngroups += grows[r].pi < 0;
+  uint64_t tsig = sig_int(SIG_INIT, view_n);
+  tsig = sig_int(tsig, snap->scan_ms * 2 + fixed);
+  tsig = sig_int(tsig, grouped ? ngroups : -1);
+  if (ch->active) {
+    tsig = sig_int(tsig, ch->spawned);
+    tsig = sig_int(tsig, ch->exited);
+    tsig = sig_int(tsig, llround(ch->exited_cpu_pct * 10));
+  }
+  if (widget_dirty(W_TITLE, tsig)) {
+    attron(COLOR_PAIR(C_HEADER) | A_BOLD);
+    mvhline(0, 0, ' ', W);
+    mvprintw(0, 2, "Process Manager - %d processes", view_n);
+    if (grouped)
+      printw(" in %d cgroups", ngroups);
+    if (scope_path)
+      printw(" under %s", scope_path);
+    if (snap->scan_ms)
+      printw("  [scan %.2gs %s]", snap->scan_ms / 1000.0,
+             fixed ? "fixed" : "auto");
+    if (ch->active)
+      printw("  (+%d spawned, -%d exited, %.1f%% CPU in exited)", ch->spawned,
+             ch->exited, ch->exited_cpu_pct);
+    attroff(COLOR_PAIR(C_HEADER) | A_BOLD);
+  }
 
   int barw = (cw / 3) * 2;
   if (barw < 20)
@@ -1431,66 +6868,57 @@ static void draw_procs(void) {
   if (barw > cw - 8)
     barw = cw - 8;
 
-  double pct = cpu.total;
+  double pct = snap->cpu.total;
   int filled = (int)(pct * barw);
   int col = get_color(pct);
 
-  attron(COLOR_PAIR(col) | A_BOLD);
-  mvhline(2, sx + 6, ACS_CKBOARD, filled);
-  attroff(COLOR_PAIR(col) | A_BOLD);
-  attron(COLOR_PAIR(C_DIM_WHITE));
-  mvhline(2, sx + 6 + filled, ACS_CKBOARD, barw - filled);
-  attroff(COLOR_PAIR(C_DIM_WHITE));
+  uint64_t csig = sig_int(sig_int(SIG_INIT, filled), (int)(pct * 100));
+  if (widget_dirty(W_BOX0, csig)) {
+    mvprintw(2, sx, "CPU:");
+    attron(COLOR_PAIR(col) | A_BOLD);
+    mvhline(2, sx + 6, ACS_CKBOARD, filled);
+    attroff(COLOR_PAIR(col) | A_BOLD);
+    attron(COLOR_PAIR(C_DIM_WHITE));
+    mvhline(2, sx + 6 + filled, ACS_CKBOARD, barw - filled);
+    attroff(COLOR_PAIR(C_DIM_WHITE));
 
-  mvprintw(2, sx + 6 + barw + 2, "%3d%%", (int)(pct * 100));
+    mvprintw(2, sx + 6 + barw + 2, "%3d%%", (int)(pct * 100));
+  }
 
-  unsigned long mt = 0, mf = 0, ma = 0;
-  mem_read_kb(&mt, &mf, &ma);
+  unsigned long mt = snap->mem.total_kb, ma = snap->mem.avail_kb;
 
   double mem_used = mt - ma;
   double mem_avail = ma;
   double used_pct = mt ? (double)mem_used / mt : 0.0;
   double avail_pct = mt ? (double)mem_avail / mt : 0.0;
 
-  mvprintw(3, sx, "MEM:");
-
   filled = (int)(used_pct * barw);
   col = get_color(used_pct);
 
-  attron(COLOR_PAIR(col) | A_BOLD);
-  mvhline(3, sx + 6, ACS_CKBOARD, filled);
-  attroff(COLOR_PAIR(col) | A_BOLD);
-  attron(COLOR_PAIR(C_DIM_WHITE));
-  mvhline(3, sx + 6 + filled, ACS_CKBOARD, barw - filled);
-  attroff(COLOR_PAIR(C_DIM_WHITE));
-
   char mem_str[100];
   snprintf(mem_str, sizeof(mem_str),
            "Used:%3d%%  Avail:%3d%%  (Used:%luMB  Avail:%luMB)",
            (int)(used_pct * 100), (int)(avail_pct * 100),
            (unsigned long)mem_used / 1024, (unsigned long)mem_avail / 1024);
 
-  mvprintw(3, sx + 6 + barw + 2, "%s", mem_str);
-
-  attron(A_BOLD | COLOR_PAIR(C_HEADER));
-  char header_fmt[128];
-  snprintf(header_fmt, sizeof(header_fmt), "%%-%ds", cw);
-  mvprintw(5, sx, header_fmt,
-           " PID    COMMAND              USER         CPU%%      MEM(MB)   NI "
-           "STATE  PRI");
-  attroff(A_BOLD | COLOR_PAIR(C_HEADER));
+  if (widget_dirty(W_BOX1, sig_str(sig_int(SIG_INIT, filled), mem_str))) {
+    move(3, 0);
+    clrtoeol();
+    mvprintw(3, sx, "MEM:");
+    attron(COLOR_PAIR(col) | A_BOLD);
+    mvhline(3, sx + 6, ACS_CKBOARD, filled);
+    attroff(COLOR_PAIR(col) | A_BOLD);
+    attron(COLOR_PAIR(C_DIM_WHITE));
+    mvhline(3, sx + 6 + filled, ACS_CKBOARD, barw - filled);
+    attroff(COLOR_PAIR(C_DIM_WHITE));
 
-  if (nprocs > 0) {
-    if (sort_mode == 0)
-      qsort(procs, nprocs, sizeof(PInfo), cmp_cpu);
-    else
-      qsort(procs, nprocs, sizeof(PInfo), cmp_mem);
+    mvprintw(3, sx + 6 + barw + 2, "%s", mem_str);
   }
 
   if (proc_sel < 0)
     proc_sel = 0;
-  if (proc_sel >= nprocs && nprocs > 0)
-    proc_sel = nprocs - 1;
+  if (proc_sel >= nrows && nrows > 0)
+    proc_sel = nrows - 1;
 
   int rows = H - 8;
   if (rows < 1)
@@ -1500,65 +6928,847 @@ static void draw_procs(void) {
   if (start < 0)
     start = 0;
   int end = start + rows;
-  if (end > nprocs)
-    end = nprocs;
+  if (end > nrows)
+    end = nrows;
   if (start > end - rows && end >= rows)
     start = end - rows;
   if (start < 0)
     start = 0;
 
-  int y = 6;
   int name_w = cw - 60;
   if (name_w < 10)
     name_w = 10;
 
-  for (int i = start; i < end && i < nprocs; i++) {
-    if (y >= H - 1)
+  // Rows are painted by screen position: a row whose text, colour and
+  // selection state match the previous frame is left alone, and rows past
+  // the end of the table are blanked once.
+  const int *idx = grouped ? NULL : order_ensure(sort_mode, end);
+  if (ext && (idx || grouped)) {
+    // Tell the sampler which rows are on screen for the extra counters.
+    pthread_mutex_lock(&ext_lock);
+    ext_nwant = 0;
+    for (int i = start; i < end && ext_nwant < EXT_WANT_MAX; i++) {
+      const PInfo *p = idx ? &view[idx[i]] : list_proc(i);
+      if (p)
+        ext_want[ext_nwant++] = p->pid;
+    }
+    pthread_mutex_unlock(&ext_lock);
+  }
+  for (int r = 0, y = 6; y < H - 1 && r < rows; r++, y++) {
+    int i = start + r;
+    char line_buf[256] = "";
+    int attr = 0;
+    const PInfo *p = NULL;
+    if (i < end)
+      p = idx ? &view[idx[i]] : list_proc(i);
+
+    if (grouped && i < end && !p) {
+      int g = grows[i].grp;
+      const GroupAgg *ga = &snap->tab->g[g - 1];
+      const char *path = ga->path;
+      size_t len = strlen(path);
+      snprintf(line_buf, sizeof(line_buf), " %c %-4d %s%-*.*s %7.1f  %9.1f",
+               grp_open[g - 1] ? '-' : '+', ga->nproc, len > 33 ? "..." : "",
+               len > 33 ? 30 : 33, len > 33 ? 30 : 33,
+               len > 33 ? path + len - 30 : path, ga->cpu_pct,
+               ga->rss_kb / 1024.0);
+      attr = i == proc_sel ? COLOR_PAIR(C_BG_SELECTED) | A_BOLD
+                           : COLOR_PAIR(C_MAGENTA) | A_BOLD;
+    } else if (p) {
+
+      double ui_pct = p->cpu_pct;
+      if (ui_pct < 0)
+        ui_pct = 0;
+      if (ui_pct > 9999)
+        ui_pct = 9999;
+
+      const char *uname = p->user ? p->user : "unknown";
+
+      bool is_pri = p->cls & CLS_PRIO;
+      const char *pri_mark = is_pri ? " *" : "";
+
+      int n = snprintf(line_buf, sizeof(line_buf),
+                       " %-6d %-20.20s %-12.12s %7.1f  %9.1f  %3d %-5s",
+                       p->pid, p->comm, uname, ui_pct, p->rss_kb / 1024.0,
+                       p->nicev, p->running ? "RUN" : "STOP");
+      if (ext && n > 0 && (size_t)n < sizeof(line_buf)) {
+        char rd[16] = "-", wr[16] = "-", cs[16] = "-";
+        if (p->ext & EXT_IO) {
+          fmt_rate(rd, sizeof(rd), p->rd_bps);
+          fmt_rate(wr, sizeof(wr), p->wr_bps);
+        }
+        if (p->ext & EXT_CSW)
+          fmt_rate(cs, sizeof(cs), p->csw_ps);
+        n += snprintf(line_buf + n, sizeof(line_buf) - (size_t)n,
+                      " %4d %8s %8s %7s", p->threads, rd, wr, cs);
+      }
+      if (n > 0 && (size_t)n < sizeof(line_buf))
+        snprintf(line_buf + n, sizeof(line_buf) - (size_t)n, " %s",
+                 pri_mark);
+
+      line_buf[sizeof(line_buf) - 1] = '\0';
+
+      if (i == proc_sel) {
+        attr = COLOR_PAIR(C_BG_SELECTED) | A_BOLD;
+      } else {
+        int proc_color = is_pri ? C_CYAN : C_GREEN;
+        if (ui_pct > 50)
+          proc_color = C_YELLOW;
+        if (ui_pct > 75)
+          proc_color = C_RED;
+        attr = COLOR_PAIR(proc_color);
+      }
+    }
+
+    if (!widget_dirty(W_ROWS + r, sig_str(sig_int(SIG_INIT, attr), line_buf)))
+      continue;
+    move(y, 0);
+    clrtoeol();
+    attron(attr);
+    if (i == proc_sel && line_buf[0])
+      mvprintw(y, sx, "%-*s", cw, line_buf);
+    else
+      mvprintw(y, sx, "%s", line_buf);
+    attroff(attr);
+  }
+}
+
+// Thread page: the process picked with Enter in the process list.
+static int thr_scroll = 0;
+static char thr_comm[MAX_COMM] = "";
+
+static void draw_threads(void) {
+  int W = COLS, H = LINES;
+  pid_t want = (pid_t)atomic_load(&thr_pid);
+  if (ui_begin(PAGE_THREADS)) {
+    attron(COLOR_PAIR(C_HEADER) | A_BOLD);
+    mvhline(H - 1, 0, ' ', W);
+    mvprintw(H - 1, 2, "↑↓/PgUp/PgDn:Scroll  ESC/q:Back to processes");
+    attroff(COLOR_PAIR(C_HEADER) | A_BOLD);
+    attron(A_BOLD);
+    mvprintw(2, get_start_x(get_content_width()),
+             " TID     NAME             S    CPU%%  CPU        TIME   NI");
+    attroff(A_BOLD);
+  }
+  bool ready = snap->thr_pid == want && (snap->nthr > 0 || snap->thr_gone);
+
+  uint64_t tsig = sig_int(SIG_INIT, ready);
+  tsig = sig_int(tsig, snap->thr_total);
+  tsig = sig_int(tsig, snap->thr_gone);
+  if (widget_dirty(W_TITLE, tsig)) {
+    attron(COLOR_PAIR(C_HEADER) | A_BOLD);
+    mvhline(0, 0, ' ', W);
+    mvprintw(0, 2, "Threads - PID %d (%s)", (int)want, thr_comm);
+    if (ready && snap->thr_gone)
+      printw(" - process has exited");
+    else if (ready)
+      printw(" - %d threads", snap->thr_total);
+    attroff(COLOR_PAIR(C_HEADER) | A_BOLD);
+  }
+
+  int sx = get_start_x(get_content_width());
+  int rows = H - 4, n = ready ? snap->nthr : 0;
+  if (thr_scroll > n - rows)
+    thr_scroll = n - rows;
+  if (thr_scroll < 0)
+    thr_scroll = 0;
+  for (int r = 0; r < rows; r++) {
+    int i = thr_scroll + r;
+    char line[128] = "";
+    int attr = 0;
+    if (i < n) {
+      const ThreadRow *t = &snap->thr[i];
+      unsigned long long cs =
+          t->ticks * 100 / (unsigned long long)ticks_per_sec;
+      char tm[24];
+      snprintf(tm, sizeof(tm), "%llu:%02llu.%02llu", cs / 6000, cs / 100 % 60,
+               cs % 100);
+      snprintf(line, sizeof(line), " %-7d %-16.16s %c %7.1f  %3d %11s  %3d",
+               (int)t->tid, t->name, t->state, t->cpu_pct, t->cpu_last, tm,
+               t->nicev);
+      attr = COLOR_PAIR(t->cpu_pct > 75   ? C_RED
+                        : t->cpu_pct > 50 ? C_YELLOW
+                                          : C_GREEN);
+    } else if (r == 0 && !ready) {
+      snprintf(line, sizeof(line), " collecting...");
+    }
+    if (!widget_dirty(W_ROWS + r, sig_str(sig_int(SIG_INIT, attr), line)))
+      continue;
+    move(3 + r, 0);
+    clrtoeol();
+    attron(attr);
+    mvprintw(3 + r, sx, "%s", line);
+    attroff(attr);
+  }
+}
+
+static void draw_page(int pg) {
+  switch (pg) {
+  case PAGE_MAIN:
+    draw_main();
+    break;
+  case PAGE_GRAPH:
+    draw_graphs();
+    break;
+  case PAGE_SYSINFO:
+    draw_sysinfo();
+    break;
+  case PAGE_HELP:
+    draw_help();
+    break;
+  case PAGE_ABOUT:
+    draw_about();
+    break;
+  case PAGE_PROCS:
+    draw_procs();
+    break;
+  case PAGE_RESOURCE_MGR:
+    draw_resource_mgr();
+    break;
+  case PAGE_THREADS:
+    draw_threads();
+    break;
+  }
+}
+
+// ---------- Profile Overlay ----------
+static void prof_row(int y, int x, const char *name, ProfStat st) {
+  char a[16], b[16];
+  fmt_ns(a, sizeof(a), st.p50);
+  fmt_ns(b, sizeof(b), st.p99);
+  mvprintw(y, x, "%-14s %9s %9s", name, a, b);
+}
+
+// Redrawn whenever a snapshot lands or anything underneath was repainted.
+static void draw_prof_overlay(void) {
+  const ProfSnap *ps = &snap->prof;
+  bool under = frame_dirty;
+  if (!widget_dirty(W_PROF, sig_int(SIG_INIT, (long long)snap->seq)) &&
+      !under)
+    return;
+  int w = 38, h = NPS + 9;
+  int x = COLS - w - 1, y = 1;
+  if (x < 0 || h > LINES - 2)
+    return;
+  clear_rect(y, x, h, w);
+  draw_box(y, x, h, w);
+  attron(COLOR_PAIR(C_CYAN) | A_BOLD);
+  mvprintw(y, x + 2, " neotop self ");
+  attroff(COLOR_PAIR(C_CYAN) | A_BOLD);
+  attron(A_BOLD);
+  mvprintw(y + 1, x + 2, "%-14s %9s %9s", "stage", "p50", "p99");
+  attroff(A_BOLD);
+  int r = y + 2;
+  for (int i = 0; i < NPS; i++)
+    prof_row(r++, x + 2, ps_name[i], ps->stage[i]);
+  char label[24];
+  snprintf(label, sizeof(label), "draw %s", page_name[page]);
+  prof_row(r++, x + 2, label, prof_stat(&prof_draw[page]));
+  prof_row(r++, x + 2, "sort", prof_stat(&prof_sort));
+  if (!ps->valid || ps->interval_ms <= 0) {
+    mvprintw(r, x + 2, "collecting...");
+    return;
+  }
+  double sec = ps->interval_ms / 1000.0;
+  char sc[16], rb[16];
+  fmt_rate(sc, sizeof(sc), ps->syscalls / sec);
+  fmt_rate(rb, sizeof(rb), ps->read_bytes / sec);
+  mvprintw(r++, x + 2, "cpu %.1f%%  rss %.1f MB", ps->cpu_pct,
+           ps->rss_kb / 1024.0);
+  mvprintw(r++, x + 2, "syscalls/s %s  read %sB/s", sc, rb);
+  mvprintw(r++, x + 2, "procs scanned %d", ps->nprocs);
+}
+
+#define HOST_TAG_W 40
+
+static void draw_host_tag(void) {
+  char tag[HOST_TAG_W + 1];
+  snprintf(tag, sizeof(tag), " %s  %d/%d  %s ",
+           snap->host ? snap->host : "connecting",
+           atomic_load(&remote_sel) + 1, nremote_addrs,
+           snap->host_up ? "live" : "down");
+  bool under = frame_dirty;
+  if (!widget_dirty(W_HOST, sig_str(SIG_INIT, tag)) && !under)
+    return;
+  int x = COLS - HOST_TAG_W - 1;
+  if (x < 0)
+    return;
+  attron(COLOR_PAIR(C_HEADER) | A_BOLD);
+  mvprintw(0, x, "%*s", HOST_TAG_W, tag);
+  attroff(COLOR_PAIR(C_HEADER) | A_BOLD);
+}
+
+// ---------- Bench ----------
+// -B builds synthetic procfs trees, each a PID count times a CPU count
+// ("1000x8,10000x64"; "all" runs 1k/10k/50k PIDs at 8/64/256 CPUs). It
+// points the collectors at them through proc_root and times each collector
+// backend on the same code paths a live run takes. The pages are then
+// rendered from the scanned fixture on an off-screen terminal writing to
+// /dev/null, once with a forced full redraw per frame and once steady.
+//
+// -B FILE instead replays a recording made with -o bin. Each record in turn
+// is applied to a PID-ordered table the way a remote daemon's frame is, and
+// published through remote_publish(); the pages are then drawn from it
+// off-screen as above, one record per frame, starting over at the end of the
+// file; runs/s of a draw line include applying the record, p50 and p99 are
+// the draw alone. A recording has no users, threads, CPU categories or PSI,
+// so user names come from this host's passwd and the rest reads as zero.
+//
+// syscalls and bytes are the read and write syscalls (syscr + syscw, so a
+// draw line counts the terminal writes too) and rchar from /proc/self/io,
+// per PID for scans and per call otherwise. heap is the
+// growth of malloc's in-use bytes over the run. Each line runs for at least
+// BENCH_MS and three iterations.
+#define BENCH_MS 1000
+
+typedef struct {
+  int pids, cpus;
+} BenchFix;
+
+typedef struct {
+  long n;
+  long long ns;
+  unsigned long long sysc, rchar;
+  long long heap;
+} BenchRun;
+
+static const char *bench_spec = NULL;
+
+static const char *bench_comms[] = {
+    "bash",     "python3", "Web Content", "kworker/3:1", "postgres",
+    "node",     "chrome",  "sshd",        "java",        "systemd-journal",
+    "pipewire", "rustc",   "cc1plus",     "nginx",       "Xorg"};
+#define N_BENCH_COMMS (int)(sizeof(bench_comms) / sizeof(bench_comms[0]))
+
+static bool bench_put(int dfd, const char *name, const OutBuf *b) {
+  if (b->bad)
+    return false;
+  int fd = openat(dfd, name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+    return false;
+  bool ok = write_all(fd, b->p, b->n);
+  close(fd);
+  return ok;
+}
+
+// xorshift32: the same fixture on every run and every host.
+static uint32_t bench_rnd(uint32_t *s) {
+  *s ^= *s << 13;
+  *s ^= *s >> 17;
+  *s ^= *s << 5;
+  return *s;
+}
+
+static bool bench_build(int dfd, const BenchFix *fx) {
+  OutBuf b = {0};
+  bool ok = true;
+  uint32_t rng = 2463534242u;
+
+  for (int c = -1; c < fx->cpus; c++) {
+    unsigned long long u = 100000 + bench_rnd(&rng) % 50000, idle = 400000;
+    if (c < 0)
+      ob_printf(&b, "cpu  ");
+    else
+      ob_printf(&b, "cpu%d ", c);
+    ob_printf(&b, "%llu 120 %llu %llu 300 0 90 0 0 0\n", u, u / 3, idle);
+  }
+  ob_printf(&b, "intr 0\nctxt 123456789\nbtime 1700000000\n"
+                "processes %d\nprocs_running 3\nprocs_blocked 0\n",
+            fx->pids);
+  ok = ok && bench_put(dfd, "stat", &b);
+
+  b.n = 0;
+  ob_printf(&b, "MemTotal:       32768000 kB\nMemFree:         8192000 kB\n"
+                "MemAvailable:   16384000 kB\nBuffers:          512000 kB\n"
+                "Cached:          6144000 kB\nSwapCached:            0 kB\n"
+                "Active:          9000000 kB\nInactive:        7000000 kB\n"
+                "SwapTotal:       8388604 kB\nSwapFree:        8000000 kB\n");
+  ok = ok && bench_put(dfd, "meminfo", &b);
+
+  char name[16];
+  for (int i = 0; ok && i < fx->pids; i++) {
+    int pid = i + 1;
+    snprintf(name, sizeof(name), "%d", pid);
+    if (mkdirat(dfd, name, 0755) != 0 && errno != EEXIST)
+      ok = false;
+    int pd = openat(dfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (pd < 0) {
+      ok = false;
       break;
+    }
+    const char *comm = bench_comms[bench_rnd(&rng) % N_BENCH_COMMS];
+    char state = bench_rnd(&rng) % 8 ? 'S' : 'R';
+    unsigned minflt = bench_rnd(&rng) % 100000;
+    unsigned ut = bench_rnd(&rng) % 500000, st = bench_rnd(&rng) % 100000;
+    int nice = (int)(bench_rnd(&rng) % 40) - 20;
+    unsigned threads = 1 + bench_rnd(&rng) % 32;
+    unsigned start = 1000 + bench_rnd(&rng) % 1000000;
+    unsigned vsize = bench_rnd(&rng) % 1000000000;
+    unsigned rss = bench_rnd(&rng) % 200000;
+    int cpu_last = (int)(bench_rnd(&rng) % (unsigned)fx->cpus);
+    b.n = 0;
+    ob_printf(&b, "%d (%s) %c 1 %d %d 0 -1 4194560 %u 0 0 0 %u %u 0 0 20 %d"
+                  " %u 0 %u %u %u",
+              pid, comm, state, pid, pid, minflt, ut, st, nice, threads,
+              start, vsize, rss);
+    ob_printf(&b, " 18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 %d"
+                  " 0 0 0 0 0 0 0 0 0 0 0 0 0\n",
+              cpu_last);
+    ok = bench_put(pd, "stat", &b);
+    close(pd);
+  }
+  free(b.p);
+  return ok;
+}
 
-    PInfo *p = &procs[i];
+static void bench_remove(int dfd, const BenchFix *fx) {
+  char path[32];
+  for (int i = 0; i < fx->pids; i++) {
+    snprintf(path, sizeof(path), "%d/stat", i + 1);
+    unlinkat(dfd, path, 0);
+    snprintf(path, sizeof(path), "%d", i + 1);
+    unlinkat(dfd, path, AT_REMOVEDIR);
+  }
+  unlinkat(dfd, "stat", 0);
+  unlinkat(dfd, "meminfo", 0);
+}
+
+// Drops every descriptor and PID entry that points into the previous tree,
+// so each backend starts cold on the current one.
+static void bench_reset(void) {
+  for (size_t i = 0; i < ptab_cap; i++) {
+    if (ptab[i].pid != 0 && ptab[i].fdslot)
+      fdc_release(ptab[i].fdslot);
+    ptab[i].pid = 0;
+  }
+  ptab_len = 0;
+  n_suspended = 0;
+}
+
+static void bench_root(const char *root) {
+  if (proc_dfd >= 0)
+    close(proc_dfd);
+  if (procstat_fd >= 0)
+    close(procstat_fd);
+  if (meminfo_fd >= 0)
+    close(meminfo_fd);
+  proc_dfd = procstat_fd = meminfo_fd = -1;
+  proc_root = root;
+}
 
-    char line_buf[256];
-    double ui_pct = p->cpu_pct;
-    if (ui_pct < 0)
-      ui_pct = 0;
-    if (ui_pct > 9999)
-      ui_pct = 9999;
+static void self_io(unsigned long long *sc, unsigned long long *rb) {
+  static int fd = -1;
+  char buf[512];
+  *sc = *rb = 0;
+  if (self_read("/proc/self/io", &fd, buf, sizeof(buf)) > 0) {
+    *sc = io_field(buf, "syscr:") + io_field(buf, "syscw:");
+    *rb = io_field(buf, "rchar:");
+  }
+}
 
-    const char *uname = uname_from_uid(p->uid);
-    if (!uname)
-      uname = "unknown";
+static long long heap_used(void) {
+  struct mallinfo2 mi = mallinfo2();
+  return (long long)(mi.uordblks + mi.hblkhd);
+}
 
-    bool is_pri = is_priority_proc(p->comm);
-    const char *pri_mark = is_pri ? " *" : "";
+static BenchRun bench_time(void (*fn)(void)) {
+  BenchRun r = {0};
+  unsigned long long sc0, rb0, sc1, rb1;
+  long long h0 = heap_used();
+  self_io(&sc0, &rb0);
+  long long t0 = now_ns();
+  do {
+    fn();
+    r.n++;
+  } while (r.n < 3 || now_ns() - t0 < BENCH_MS * 1000000LL);
+  r.ns = now_ns() - t0;
+  self_io(&sc1, &rb1);
+  // Less the two reads of /proc/self/io itself.
+  r.sysc = sc1 - sc0 > 1 ? sc1 - sc0 - 1 : 0;
+  r.rchar = rb1 - rb0;
+  r.heap = heap_used() - h0;
+  return r;
+}
 
-    snprintf(line_buf, sizeof(line_buf),
-             " %-6d %-20.20s %-12.12s %7.1f  %9.1f  %3d %-5s %s", p->pid,
-             p->comm, uname, ui_pct, p->rss_kb / 1024.0, p->nicev,
-             p->running ? "RUN" : "STOP", pri_mark);
+static void bench_line(const char *name, const BenchRun *r, ProfStat st,
+                       double per) {
+  char a[16], b[16];
+  fmt_ns(a, sizeof(a), st.p50);
+  fmt_ns(b, sizeof(b), st.p99);
+  double k = per * (double)r->n;
+  printf("  %-20s %10.1f %9s %9s %9.2f %10.1f %9lld\n", name,
+         r->n * 1e9 / (double)r->ns, a, b, r->sysc / k, r->rchar / k,
+         r->heap / 1024);
+}
 
-    line_buf[sizeof(line_buf) - 1] = '\0';
+static void bench_scan(void) { scan_processes(); }
 
-    if (i == proc_sel) {
-      attron(COLOR_PAIR(C_BG_SELECTED) | A_BOLD);
-      mvprintw(y, sx, "%-*s", cw, line_buf);
-      attroff(COLOR_PAIR(C_BG_SELECTED) | A_BOLD);
-    } else {
-      int proc_color = is_pri ? C_CYAN : C_GREEN;
-      if (ui_pct > 50)
-        proc_color = C_YELLOW;
-      if (ui_pct > 75)
-        proc_color = C_RED;
+static int bench_page;
+static bool bench_full;
+static ProfRing bench_ring;
 
-      attron(COLOR_PAIR(proc_color));
-      mvprintw(y, sx, "%s", line_buf);
-      attroff(COLOR_PAIR(proc_color));
+static void bench_draw(void) {
+  long long t0 = now_ns();
+  if (bench_full)
+    drawn_page = -1;
+  ui_sync();
+  draw_page(bench_page);
+  ui_end();
+  prof_add(&bench_ring, t0);
+}
+
+static void bench_fixture(const char *dir, const BenchFix *fx, bool curses) {
+  int ncpu_real = NCPU;
+  NCPU = fx->cpus;
+  bench_root(dir);
+  cpu_sample();
+  printf("%d pids x %d cpus", fx->pids, fx->cpus);
+  if (cpu.ncores < fx->cpus)
+    printf(" (per-core figures for the first %d)", cpu.ncores);
+  printf("\n");
+  printf("  %-20s %10s %9s %9s %9s %10s %9s\n", "collector", "runs/s", "p50",
+         "p99", "syscalls", "bytes", "heap KiB");
+
+  prof[PS_CPU].n = 0;
+  BenchRun r = bench_time(cpu_sample);
+  bench_line("cpu_sample", &r, prof_stat(&prof[PS_CPU]), 1);
+  prof[PS_MEM].n = 0;
+  r = bench_time(push_mem_hist);
+  bench_line("mem_read", &r, prof_stat(&prof[PS_MEM]), 1);
+
+  int nthreads[2] = {1, ncpu_real > 1 ? ncpu_real : 0};
+  for (int t = 0; t < 2; t++) {
+    if (!nthreads[t])
+      continue;
+    for (int pf = 0; pf < 2; pf++) {
+      if (pf && !fdc)
+        fdc_init();
+      persist_fds = pf;
+      scan_threads = nthreads[t];
+      bench_reset();
+      pool_start();
+      scan_processes(); // cold pass: listing, PID table growth, fd adoption
+      prof[PS_SCAN].n = 0;
+      r = bench_time(bench_scan);
+      pool_stop();
+      char name[32];
+      snprintf(name, sizeof(name), "scan %s -j%d", pf ? "pread" : "open",
+               nthreads[t]);
+      bench_line(name, &r, prof_stat(&prof[PS_SCAN]), fx->pids);
     }
+  }
 
-    y++;
+  if (curses) {
+    cpu_sample();
+    sysi_sample();
+    snap_publish();
+    static const int pages[] = {PAGE_PROCS, PAGE_GRAPH, PAGE_SYSINFO,
+                                PAGE_MAIN};
+    for (int i = 0; i < 4; i++) {
+      for (int full = 1; full >= 0; full--) {
+        bench_page = pages[i];
+        bench_full = full;
+        bench_ring.n = 0;
+        drawn_page = -1;
+        r = bench_time(bench_draw);
+        char name[32];
+        snprintf(name, sizeof(name), "draw %s %s", page_name[pages[i]],
+                 full ? "full" : "steady");
+        bench_line(name, &r, prof_stat(&bench_ring), 1);
+      }
+    }
+  }
+  persist_fds = false;
+  bench_reset();
+  NCPU = ncpu_real;
+}
+
+static uint64_t ib_le(InBuf *b, int bytes) {
+  if (b->end - b->p < bytes) {
+    b->bad = true;
+    b->p = b->end;
+    return 0;
+  }
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; i++)
+    v |= (uint64_t)b->p[i] << (8 * i);
+  b->p += bytes;
+  return v;
+}
+
+static double ib_f32(InBuf *b) {
+  uint32_t u = (uint32_t)ib_le(b, 4);
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+static void ib_comm(InBuf *b, char *out) {
+  unsigned len = ib_u8(b);
+  if (len > (size_t)(b->end - b->p)) {
+    b->bad = true;
+    len = 0;
+  }
+  size_t k = len < MAX_COMM - 1 ? len : MAX_COMM - 1;
+  memcpy(out, b->p, k);
+  out[k] = '\0';
+  b->p += len;
+}
+
+static unsigned char *rp_data = NULL;
+static size_t rp_len = 0, rp_off = 0;
+static Remote rp_state;
+
+// Applies one record of the format described under Headless Output to
+// rp_state. The system figures go through the globals and wire_pack(), so
+// remote_publish() can unpack them like a daemon's.
+static bool replay_apply(InBuf *b) {
+  Remote *r = &rp_state;
+  unsigned ver = ib_u8(b);
+  ib_le(b, 8); // t_ms
+  ib_le(b, 4); // seq
+  int nc = (int)ib_le(b, 2);
+  if (b->bad || (ver != 1 && ver != 2) || nc < 1 || nc > MAX_CORES)
+    return false;
+  cpu = (CpuSnap){.ncores = nc, .nstat = nc};
+  cpu.total = ib_f32(b);
+  for (int i = 0; i < nc; i++)
+    cpu.core[i] = ib_f32(b);
+  for (int i = 0; i < nc; i++)
+    sens.freq_mhz[i] = ib_f32(b);
+  sens.temp_c = ib_f32(b);
+  sens.temp_ok = sens.temp_c > 0;
+  unsigned long *mv[7] = {&mem.total_kb,      &mem.free_kb,
+                          &mem.avail_kb,      &mem.buffers_kb,
+                          &mem.cached_kb,     &mem.swap_total_kb,
+                          &mem.swap_free_kb};
+  for (int i = 0; i < 7; i++)
+    *mv[i] = (unsigned long)ib_le(b, 8);
+  psi = (PsiSnap){0};
+  wire_pack(&r->sys);
+  ib_le(b, 4); // nprocs
+
+  int nnew = ib_count(b, ib_le(b, 4));
+  if (b->bad || !remote_reserve(&r->nv, &r->ncap, (size_t)r->n + (size_t)nnew))
+    return false;
+  PInfo *fresh = r->nv + r->n;
+  for (int i = 0; i < nnew && !b->bad; i++) {
+    PInfo *p = &fresh[i];
+    *p = (PInfo){0};
+    p->pid = (pid_t)ib_le(b, 4);
+    p->uid = (uid_t)ib_le(b, 4);
+    p->user = uid_name(p->uid);
+    ib_comm(b, p->comm);
+    p->cpu_pct = ib_f32(b);
+    p->rss_kb = (unsigned long)ib_le(b, 8);
+    p->nicev = (int8_t)ib_le(b, 1);
+    p->running = ib_le(b, 1) != 0;
+  }
+  int nchg = ib_count(b, ib_le(b, 4));
+  for (int i = 0; i < nchg && !b->bad; i++) {
+    pid_t pid = (pid_t)ib_le(b, 4);
+    unsigned m = (unsigned)ib_le(b, 1);
+    PInfo *p = bsearch(&pid, r->v, (size_t)r->n, sizeof(PInfo), cmp_pid_key);
+    PInfo dummy;
+    if (!p)
+      p = &dummy;
+    if (m & D_COMM)
+      ib_comm(b, p->comm);
+    if (m & D_CPU)
+      p->cpu_pct = ib_f32(b);
+    if (m & D_RSS)
+      p->rss_kb = (unsigned long)ib_le(b, 8);
+    if (m & D_NICE)
+      p->nicev = (int8_t)ib_le(b, 1);
+    if (m & D_RUN)
+      p->running = ib_le(b, 1) != 0;
+  }
+  int nexit = ib_count(b, ib_le(b, 4));
+  for (int i = 0; i < nexit && !b->bad; i++) {
+    pid_t pid = (pid_t)ib_le(b, 4);
+    PInfo *p = bsearch(&pid, r->v, (size_t)r->n, sizeof(PInfo), cmp_pid_key);
+    if (p)
+      p->pid = 0;
+  }
+  // A version 2 record ends with a profile block, which is not replayed.
+  if (b->bad || (ver == 1 && b->p != b->end) || !remote_merge(r, nnew))
+    return false;
+  r->have = true;
+  return true;
+}
+
+// Applies and publishes the next record, wrapping to the first at the end.
+static bool replay_next(void) {
+  if (rp_off + 4 > rp_len) {
+    rp_off = 0;
+    rp_state.n = 0; // the first record lists every process as new
+  }
+  InBuf hdr = {rp_data + rp_off, rp_data + rp_len, false};
+  uint64_t len = ib_le(&hdr, 4);
+  if (len > (uint64_t)(hdr.end - hdr.p))
+    return false;
+  InBuf body = {hdr.p, hdr.p + len, false};
+  if (!replay_apply(&body))
+    return false;
+  rp_off += 4 + (size_t)len;
+  remote_publish(&rp_state);
+  return true;
+}
+
+static void bench_replay_next(void) {
+  long long t0 = now_ns();
+  replay_next();
+  prof_add(&bench_ring, t0);
+}
+
+static void bench_replay_draw(void) {
+  replay_next();
+  bench_draw();
+}
+
+static int bench_replay(const char *path, bool curses) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    fprintf(stderr, "neotop: %s: %s\n", path, strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return 1;
+  }
+  rp_len = (size_t)st.st_size;
+  rp_data = malloc(rp_len ? rp_len : 1);
+  size_t got = 0;
+  ssize_t n = 1;
+  while (rp_data && got < rp_len && n > 0) {
+    n = read_retry(fd, (char *)rp_data + got, rp_len - got, -1);
+    got += n > 0 ? (size_t)n : 0;
+  }
+  bool ok = rp_data && got == rp_len;
+  close(fd);
+
+  // A first pass checks every record and counts them.
+  rp_state = (Remote){.addr = path, .fd = -1, .host = intern_name("replay")};
+  long nrec = 0;
+  rp_off = 0;
+  while (ok && rp_off + 4 <= rp_len) {
+    ok = replay_next();
+    nrec++;
+  }
+  if (!ok || !nrec) {
+    fprintf(stderr, "neotop: %s: bad -o bin recording at byte %zu\n", path,
+            rp_off);
+    free(rp_data);
+    return 1;
+  }
+  printf("replay %s: %ld records, %d cpus, %d pids in the last\n", path,
+         nrec, cpu.ncores, rp_state.n);
+  printf("  %-20s %10s %9s %9s %9s %10s %9s\n", "stage", "runs/s", "p50",
+         "p99", "syscalls", "bytes", "heap KiB");
+
+  bench_ring.n = 0;
+  BenchRun r = bench_time(bench_replay_next);
+  bench_line("apply+publish", &r, prof_stat(&bench_ring), 1);
+  if (curses) {
+    static const int pages[] = {PAGE_PROCS, PAGE_GRAPH, PAGE_SYSINFO,
+                                PAGE_MAIN};
+    for (int i = 0; i < 4; i++) {
+      for (int full = 1; full >= 0; full--) {
+        bench_page = pages[i];
+        bench_full = full;
+        bench_ring.n = 0;
+        drawn_page = -1;
+        r = bench_time(bench_replay_draw);
+        char name[32];
+        snprintf(name, sizeof(name), "draw %s %s", page_name[pages[i]],
+                 full ? "full" : "steady");
+        bench_line(name, &r, prof_stat(&bench_ring), 1);
+      }
+    }
+  }
+  free(rp_data);
+  rp_data = NULL;
+  return 0;
+}
+
+static int bench_run(void) {
+  static const BenchFix all[] = {{1000, 8},   {1000, 64},   {1000, 256},
+                                 {10000, 8},  {10000, 64},  {10000, 256},
+                                 {50000, 8},  {50000, 64},  {50000, 256}};
+  BenchFix fx[16];
+  int nfx = 0;
+  bool replay = strcmp(bench_spec, "all") &&
+                !isdigit((unsigned char)bench_spec[0]);
+  if (!strcmp(bench_spec, "all")) {
+    nfx = (int)(sizeof(all) / sizeof(all[0]));
+    memcpy(fx, all, sizeof(all));
+  } else if (!replay) {
+    for (const char *p = bench_spec; *p && nfx < 16;) {
+      char *e;
+      long n = strtol(p, &e, 10), c = 0;
+      if (*e == 'x')
+        c = strtol(e + 1, &e, 10);
+      if (n <= 0 || c <= 0 || (*e && *e != ',')) {
+        fprintf(stderr, "neotop: bad -B spec '%s' (want PIDSxCPUS,...)\n",
+                bench_spec);
+        return 1;
+      }
+      fx[nfx++] = (BenchFix){(int)n, (int)c};
+      p = *e ? e + 1 : e;
+    }
+  }
+
+  const char *tmp = getenv("TMPDIR");
+  char dir[256];
+  int dfd = -1;
+  if (!replay) {
+    snprintf(dir, sizeof(dir), "%s/neotop-bench-XXXXXX", tmp ? tmp : "/tmp");
+    if (!mkdtemp(dir)) {
+      fprintf(stderr, "neotop: mkdtemp %s: %s\n", dir, strerror(errno));
+      return 1;
+    }
+    dfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd < 0)
+      return 1;
   }
 
-  refresh();
+  // An off-screen terminal: output goes to /dev/null at a fixed size.
+  FILE *tout = fopen("/dev/null", "w"), *tin = fopen("/dev/null", "r");
+  SCREEN *scr = NULL;
+  if (tout && tin)
+    scr = newterm(getenv("TERM") ? NULL : "xterm", tout, tin);
+  if (scr) {
+    set_term(scr);
+    resizeterm(50, 160);
+    if (has_colors())
+      init_colors();
+  } else {
+    fprintf(stderr, "neotop: no terminal description, skipping rendering\n");
+  }
+
+  int rc = replay ? bench_replay(bench_spec, scr != NULL) : 0;
+  for (int i = 0; i < nfx && !rc; i++) {
+    if (!bench_build(dfd, &fx[i])) {
+      fprintf(stderr, "neotop: cannot build fixture in %s\n", dir);
+      rc = 1;
+    } else {
+      bench_fixture(dir, &fx[i], scr != NULL);
+      fflush(stdout);
+    }
+    bench_remove(dfd, &fx[i]);
+  }
+  if (scr) {
+    endwin();
+    delscreen(scr);
+  }
+  if (tout)
+    fclose(tout);
+  if (tin)
+    fclose(tin);
+  if (dfd >= 0) {
+    close(dfd);
+    rmdir(dir);
+  }
+  return rc;
 }
 
 // ---------- Actions ----------
@@ -1569,14 +7779,8 @@ static void act_kill(pid_t pid) {
   kill(pid, SIGKILL);
 }
 
-static void act_stopcont(PInfo *p) {
-  if (p->running) {
-    kill(p->pid, SIGSTOP);
-    p->running = false;
-  } else {
-    kill(p->pid, SIGCONT);
-    p->running = true;
-  }
+static void act_stopcont(const PInfo *p) {
+  kill(p->pid, p->running ? SIGSTOP : SIGCONT);
 }
 
 static void act_renice(pid_t pid, int delta) {
@@ -1593,7 +7797,121 @@ static void act_renice(pid_t pid, int delta) {
 }
 
 // ---------- Main ----------
-int main(void) {
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-f] [-n] [-c] [-x] [-P] [-j threads] [-s file]"
+          " [-t ms] [-g cgroup] [-o json|bin [-O file] [-i ms]] [-r dir]"
+          " [-m policy] [-l addr [-i ms]] [-C addr[,addr...]] [-B spec]"
+          " [-h]\n"
+          "  -f  keep /proc/<pid>/stat open between scans (pread sampling)\n"
+          "  -n  track processes via the netlink proc connector (root)\n"
+          "  -c  resource manager throttles through cgroup v2 (root)\n"
+          "  -x  match priority/critical names exactly, not as substrings\n"
+          "  -m  manager policy: cpu=%%,cpu-exit=%%,rss=MB,rss-exit=MB,\n"
+          "      enter=scans,exit=scans,idle=scans,idle-cpu=%%,rate=n\n"
+          "  -P  show the self-profile overlay; with -o, add it to records\n"
+          "  -j  threads for the per-PID scan (default: CPUs / 8)\n"
+          "  -s  keep CPU/memory history in file across runs\n"
+          "  -t  fixed process scan interval in ms (default: adaptive)\n"
+          "  -g  scan only the processes in this cgroup subtree\n"
+          "  -o  headless: stream one record per interval, no UI\n"
+          "  -O  write headless records to file instead of stdout\n"
+          "  -i  headless and daemon interval in ms (default: 1500)\n"
+          "  -r  read processes and counters from dir instead of /proc\n"
+          "  -l  daemon: serve snapshots on unix:path, host:port or port\n"
+          "  -C  show daemons' snapshots instead of this machine's (Tab)\n"
+          "  -B  benchmark on synthetic trees: PIDSxCPUS[,...] or all;\n"
+          "      or replay a recording made with -o bin\n"
+          "  -h  show this help\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  int opt;
+  while ((opt = getopt(argc, argv, "fncxm:Pj:s:t:g:o:O:i:r:l:C:B:h")) != -1) {
+    switch (opt) {
+    case 'f':
+      persist_fds = true;
+      break;
+    case 'n':
+      use_netlink = true;
+      break;
+    case 'c':
+      use_cgroup = true;
+      break;
+    case 'x':
+      match_exact = true;
+      break;
+    case 'm':
+      if (!pol_parse(optarg)) {
+        fprintf(stderr, "neotop: bad -m policy '%s'\n", optarg);
+        return 1;
+      }
+      break;
+    case 'P':
+      prof_overlay = true;
+      atomic_store(&prof_on, true);
+      break;
+    case 'j':
+      scan_threads = atoi(optarg);
+      break;
+    case 's':
+      hist_path = optarg;
+      break;
+    case 'g':
+      scope_path = optarg;
+      break;
+    case 't': {
+      long ms = atol(optarg);
+      atomic_store(&cad_fixed, ms < 100 ? 100 : ms);
+      break;
+    }
+    case 'o':
+      if (!strcmp(optarg, "json")) {
+        out_fmt = OUT_JSON;
+      } else if (!strcmp(optarg, "bin")) {
+        out_fmt = OUT_BIN;
+      } else {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'O':
+      out_path = optarg;
+      break;
+    case 'r':
+      proc_root = optarg;
+      break;
+    case 'l':
+      serve_addr = optarg;
+      break;
+    case 'C':
+      for (char *save, *a = strtok_r(optarg, ",", &save); a;
+           a = strtok_r(NULL, ",", &save))
+        if (nremote_addrs < REMOTE_MAX)
+          remote_addrs[nremote_addrs++] = a;
+      break;
+    case 'B':
+      bench_spec = optarg;
+      break;
+    case 'i':
+      out_ms = atol(optarg);
+      if (out_ms < 10)
+        out_ms = 10;
+      break;
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((serve_addr && out_fmt != OUT_NONE) ||
+      (nremote_addrs && (serve_addr || out_fmt != OUT_NONE))) {
+    usage(argv[0]);
+    return 1;
+  }
   NCPU = sysconf(_SC_NPROCESSORS_ONLN);
   if (NCPU <= 0)
     NCPU = 1;
@@ -1601,7 +7919,31 @@ int main(void) {
   read_uname();
   read_cpu_info();
   detect_temp_sensor();
-  run_neofetch_stdout();
+  sysi_init();
+  if (scope_path && !scope_open(scope_path)) {
+    fprintf(stderr, "neotop: cannot open cgroup %s: %s\n", scope_path,
+            strerror(errno));
+    return 1;
+  }
+  if (persist_fds)
+    fdc_init();
+  if (use_netlink)
+    pcn_init();
+  if (bench_spec)
+    return bench_run();
+  // A viewer of remote daemons neither records nor manages this machine.
+  if (!nremote_addrs && !hist_open())
+    return 1;
+  if (out_fmt != OUT_NONE)
+    return headless_run();
+  if (serve_addr)
+    return serve_run();
+  // Only the interactive UI drives the manager that -c throttles for.
+  if (use_cgroup && !nremote_addrs) {
+    cg_init();
+    atexit(cg_teardown);
+  }
+  neofetch_load_cache();
 
   initscr();
   cbreak();
@@ -1609,75 +7951,101 @@ int main(void) {
   keypad(stdscr, TRUE);
   nodelay(stdscr, TRUE);
   curs_set(0);
+  // Focus reports let the sampler slow down while the terminal is in the
+  // background; terminals without them never send either sequence.
+  define_key("\033[I", KEY_FOCUS_IN);
+  define_key("\033[O", KEY_FOCUS_OUT);
+  putp("\033[?1004h");
   if (has_colors())
     init_colors();
 
-  long t_cpu = now_ms(), t_proc = now_ms();
-
-  cpu_sample();
-  push_mem_hist();
-  usleep(100000);
-  cpu_sample();
-  push_mem_hist();
-  read_cpu_totals();
-  scan_processes();
-
-  while (1) {
-    long t = now_ms();
-
-    if (t - t_cpu >= CPU_MS) {
-      cpu_sample();
-      push_mem_hist();
-      t_cpu = t;
-    }
-    if (t - t_proc >= PROC_MS) {
-      if (page == PAGE_PROCS || page == PAGE_MAIN ||
-          page == PAGE_RESOURCE_MGR) {
-        read_cpu_totals();
-        scan_processes();
-        if (auto_manage_enabled) {
-          manage_resources();
-        }
-      }
-      t_proc = t;
-    }
-
-    switch (page) {
-    case PAGE_MAIN:
-      draw_main();
-      break;
-    case PAGE_GRAPH:
-      draw_graphs();
-      break;
-    case PAGE_SYSINFO:
-      draw_sysinfo();
-      break;
-    case PAGE_HELP:
-      draw_help();
-      break;
-    case PAGE_ABOUT:
-      draw_about();
-      break;
-    case PAGE_PROCS:
-      draw_procs();
-      break;
-    case PAGE_RESOURCE_MGR:
-      draw_resource_mgr();
-      break;
-    }
+  // Blocked before the sampler starts so neither it nor the scan workers
+  // ever take the resize signal; ui_wait() opens it while asleep. The
+  // quitting signals go the same way and leave the loop like 'q', so the
+  // terminal and any throttled processes are restored.
+  static const int ui_sigs[] = {SIGWINCH, SIGINT, SIGTERM, SIGHUP};
+  sigset_t blocked, waitmask;
+  sigemptyset(&blocked);
+  struct sigaction sa = {0};
+  sa.sa_handler = ui_on_signal;
+  for (int i = 0; i < 4; i++) {
+    sigaddset(&blocked, ui_sigs[i]);
+    if (ui_sigs[i] != SIGWINCH)
+      sigaction(ui_sigs[i], &sa, NULL);
+  }
+  pthread_sigmask(SIG_BLOCK, &blocked, &waitmask);
+  for (int i = 0; i < 4; i++)
+    sigdelset(&waitmask, ui_sigs[i]);
+
+  atomic_store(&ui_page, page);
+  if (!sampler_init() ||
+      pthread_create(&sampler_tid, NULL,
+                     nremote_addrs ? remote_main : sampler_main, NULL) != 0) {
+    ui_teardown();
+    fprintf(stderr, "neotop: cannot start sampler thread\n");
+    return 1;
+  }
+  neofetch_start();
+
+  while (!ui_quit) {
+    if (atomic_exchange(&ui_page, page) != page)
+      sampler_kick();
+    ui_sync();
+
+    long long t0 = now_ns();
+    draw_page(page);
+    if (prof_overlay)
+      draw_prof_overlay();
+    if (nremote_addrs)
+      draw_host_tag();
+    ui_end();
+    prof_add(&prof_draw[page], t0);
 
-    napms(FRAME_MS);
     int ch = getch();
-    if (ch == ERR)
+    if (ch == ERR) {
+      ui_wait(&waitmask);
       continue;
+    }
 
     if (ch == 'q' || ch == 'Q' || ch == 27) {
       if (page != PAGE_MAIN) {
-        page = PAGE_MAIN;
+        page = page == PAGE_THREADS ? PAGE_PROCS : PAGE_MAIN;
         continue;
       }
       break;
     }
+    if (ch == KEY_FOCUS_IN || ch == KEY_FOCUS_OUT) {
+      atomic_store(&ui_focused, ch == KEY_FOCUS_IN);
+      sampler_kick();
+      continue;
+    }
+    if (nremote_addrs) {
+      // Daemons are watched, not steered: actions, the manager and anything
+      // a stream does not carry (threads, cgroups, I/O columns) stay off.
+      if (ch == '\t') {
+        atomic_store(&remote_sel,
+                     (atomic_load(&remote_sel) + 1) % nremote_addrs);
+        drawn_page = -1;
+        sampler_kick();
+        continue;
+      }
+      bool procs_key = ch > 0 && ch < 256 && strchr("KS+-Aagewit\n\r", ch);
+      if (ch == '[' || ch == ']' || ch == '=' || page == PAGE_RESOURCE_MGR ||
+          (page == PAGE_PROCS && (procs_key || ch == KEY_ENTER)))
+        continue;
+    }
+    if (ch == '[' || ch == ']' || ch == '=') {
+      cad_step(ch == '=' ? 0 : ch == ']' ? 1 : -1, snap->scan_ms);
+      sampler_kick();
+      continue;
+    }
+    if (ch == 'P') {
+      prof_overlay = !prof_overlay;
+      atomic_store(&prof_on, prof_overlay);
+      drawn_page = -1; // the overlay covers parts of the page
+      sampler_kick();
+      continue;
+    }
 
     if (page == PAGE_MAIN) {
       if (ch == KEY_UP || ch == 'k')
@@ -1691,8 +8059,8 @@ int main(void) {
           page = PAGE_SYSINFO;
         else if (menu_sel == 2) {
           page = PAGE_PROCS;
-          read_cpu_totals();
-          scan_processes();
+          atomic_store(&scan_req, true);
+          sampler_kick();
         } else if (menu_sel == 3)
           page = PAGE_RESOURCE_MGR;
         else if (menu_sel == 4)
@@ -1702,76 +8070,152 @@ int main(void) {
         else if (menu_sel == 6)
           break;
       }
+    } else if (page == PAGE_GRAPH) {
+      if (ch == 'h')
+        hist_level = (hist_level + 1) % HL_N;
+      else if (ch == 'H')
+        hist_level = (hist_level + HL_N - 1) % HL_N;
+      else if (ch == 'c')
+        graph_view = (graph_view + 1) % NGV;
     } else if (page == PAGE_RESOURCE_MGR) {
       if (ch == 'D' || ch == 'd') {
-        if (num_priority_procs > 0)
+        pthread_mutex_lock(&mgr_lock);
+        if (num_priority_procs > 0) {
           num_priority_procs--;
+          match_ver++;
+        }
+        pthread_mutex_unlock(&mgr_lock);
+        atomic_store(&scan_req, true);
+        sampler_kick();
       } else if (ch == 'T' || ch == 't') {
+        pthread_mutex_lock(&mgr_lock);
         auto_manage_enabled = !auto_manage_enabled;
-        if (!auto_manage_enabled) {
-          resume_suspended();
+        bool resume = !auto_manage_enabled;
+        pthread_mutex_unlock(&mgr_lock);
+        if (resume) {
+          atomic_store(&resume_req, true);
+          sampler_kick();
         }
       } else if (ch == 'R' || ch == 'r') {
-        resume_suspended();
+        atomic_store(&resume_req, true);
+        sampler_kick();
+      } else if (ch == 'M' || ch == 'm') {
+        pthread_mutex_lock(&mgr_lock);
+        match_exact = !match_exact;
+        match_ver++;
+        pthread_mutex_unlock(&mgr_lock);
+        atomic_store(&scan_req, true);
+        sampler_kick();
+      } else if ((ch == 'F' || ch == 'f') && cg_active) {
+        pthread_mutex_lock(&mgr_lock);
+        cg_freeze = !cg_freeze;
+        pthread_mutex_unlock(&mgr_lock);
+        sampler_kick();
       }
+    } else if (page == PAGE_THREADS) {
+      if (ch == KEY_UP || ch == 'k')
+        thr_scroll--;
+      else if (ch == KEY_DOWN || ch == 'j')
+        thr_scroll++;
+      else if (ch == KEY_PPAGE)
+        thr_scroll -= 10;
+      else if (ch == KEY_NPAGE)
+        thr_scroll += 10;
     } else if (page == PAGE_PROCS) {
+      const PInfo *sp = list_proc(proc_sel);
       if (ch == KEY_UP || ch == 'k') {
-        proc_sel--;
-        if (proc_sel < 0)
-          proc_sel = 0;
+        view_select(proc_sel - 1);
       } else if (ch == KEY_DOWN || ch == 'j') {
-        proc_sel++;
-        if (nprocs > 0 && proc_sel >= nprocs)
-          proc_sel = nprocs - 1;
+        view_select(proc_sel + 1);
       } else if (ch == KEY_PPAGE) {
-        proc_sel -= 10;
-        if (proc_sel < 0)
-          proc_sel = 0;
+        view_select(proc_sel - 10);
       } else if (ch == KEY_NPAGE) {
-        proc_sel += 10;
-        if (nprocs > 0 && proc_sel >= nprocs)
-          proc_sel = nprocs - 1;
+        view_select(proc_sel + 10);
+      } else if (ch == 'g') {
+        grouped = !grouped;
+        grows_stale = true;
+        sel_grp = sp ? sp->grp : 0;
+        if (!grouped)
+          view_follow_sel();
+        // Cgroups are only read while some view needs them.
+        if (atomic_exchange(&grp_on, grouped) != grouped && grouped) {
+          atomic_store(&scan_req, true);
+          sampler_kick();
+        }
+      } else if (ch == '\n' || ch == '\r' || ch == KEY_ENTER) {
+        if (grouped && !sp && proc_sel < ngrows) {
+          grp_open[grows[proc_sel].grp - 1] ^= 1;
+          grows_stale = true;
+        } else if (sp) {
+          atomic_store(&thr_pid, sp->pid);
+          snprintf(thr_comm, sizeof(thr_comm), "%s", sp->comm);
+          thr_scroll = 0;
+          page = PAGE_THREADS;
+        }
       } else if (ch == 'c') {
-        sort_mode = 0;
+        view_set_sort(SORT_CPU);
       } else if (ch == 'm') {
-        sort_mode = 1;
+        view_set_sort(SORT_MEM);
+      } else if (ch == 'p') {
+        view_set_sort(SORT_PID);
+      } else if (ch == 'n') {
+        view_set_sort(SORT_NAME);
+      } else if (ch == 'u') {
+        view_set_sort(SORT_USER);
+      } else if (ch == 'e' || ch == 'i' || ch == 'w' || ch == 't') {
+        bool on = ch == 'e' ? !atomic_load(&ext_cols) : true;
+        if (ch != 'e')
+          view_set_sort(ch == 'i' ? SORT_IO : ch == 'w' ? SORT_CSW : SORT_THR);
+        else if (!on && sort_mode >= SORT_IO)
+          view_set_sort(SORT_CPU);
+        if (atomic_exchange(&ext_cols, on) != on) {
+          drawn_page = -1; // the header changes
+          atomic_store(&scan_req, true);
+          sampler_kick();
+        }
       } else if (ch == 'A' || ch == 'a') {
-        if (nprocs > 0 && proc_sel >= 0 && proc_sel < nprocs &&
-            num_priority_procs < MAX_PRIORITY_PROCS) {
+        if (sp && num_priority_procs < MAX_PRIORITY_PROCS) {
           bool already_added = false;
           for (int i = 0; i < num_priority_procs; i++) {
-            if (strcmp(priority_procs[i], procs[proc_sel].comm) == 0) {
+            if (strcmp(priority_procs[i], sp->comm) == 0) {
               already_added = true;
               break;
             }
           }
           if (!already_added) {
-            strncpy(priority_procs[num_priority_procs], procs[proc_sel].comm,
-                    MAX_COMM - 1);
-            priority_procs[num_priority_procs][MAX_COMM - 1] = '\0';
+            pthread_mutex_lock(&mgr_lock);
+            snprintf(priority_procs[num_priority_procs], MAX_COMM, "%s",
+                     sp->comm);
             num_priority_procs++;
+            match_ver++;
+            pthread_mutex_unlock(&mgr_lock);
+            atomic_store(&scan_req, true);
+            sampler_kick();
           }
         }
       } else if (ch == 'K') {
-        if (nprocs > 0 && proc_sel >= 0 && proc_sel < nprocs) {
-          act_kill(procs[proc_sel].pid);
-        }
+        if (sp)
+          act_kill(sp->pid);
       } else if (ch == 'S') {
-        if (nprocs > 0 && proc_sel >= 0 && proc_sel < nprocs) {
-          act_stopcont(&procs[proc_sel]);
+        if (sp) {
+          act_stopcont(sp);
+          // Snapshots are immutable; rescan so the new state shows up now.
+          atomic_store(&scan_req, true);
+          sampler_kick();
         }
       } else if (ch == '+') {
-        if (nprocs > 0 && proc_sel >= 0 && proc_sel < nprocs) {
-          act_renice(procs[proc_sel].pid, -1);
-        }
+        if (sp)
+          act_renice(sp->pid, -1);
       } else if (ch == '-') {
-        if (nprocs > 0 && proc_sel >= 0 && proc_sel < nprocs) {
-          act_renice(procs[proc_sel].pid, +1);
-        }
+        if (sp)
+          act_renice(sp->pid, +1);
       }
     }
   }
 
-  endwin();
+  atomic_store(&samp_stop, true);
+  sampler_kick();
+  pthread_join(sampler_tid, NULL);
+  ui_teardown();
   return 0;
 }